@@ -8,74 +8,139 @@
 #include "MemPool.h"
 #include "Population.h"
 #include "Transaction.h"
+#include "EventQueue.h"
+#include "TransactionIngest.h"
+#include "ReportWriter.h"
+#include "ColumnFile.h"
 #include <time.h>
 #include <vector>
 
 namespace blockchainsim
 {
 
-    class BlockInfo
+    typedef std::vector< BlockInfo > BlockInfoVector;
+    typedef std::vector< Population * > PopulationVector;
+
+    // The columns of BlockChain.bcol: those of BlockChain.csv, with the time as seconds since 1970 and amounts in satoshis
+    static const ColumnDesc gBlockColumns[] =
     {
-    public:
-        BlockInfo(void)
-        {
-            init();
-        }
-        void init(void)
-        {
-            mTimeStamp = 0;
-            mTransactionCount = 0;
-            mBlockSize = 0;
-        }
-        uint32_t    mTimeStamp;             // time stamp for this block
-        uint32_t    mTransactionCount;      // how many transactions are in this block
-        uint32_t    mBlockSize;             // size of the block
+        { "Time", CT_UINT32 },
+        { "BlockTime", CT_FLOAT },
+        { "BlockSize", CT_UINT32 },
+        { "TPS", CT_DOUBLE },
+        { "TransactionCount", CT_UINT32 },
+        { "BlockValue", CT_INT64 },
+        { "BlockFees", CT_INT64 },
+        { "MemPoolCount", CT_UINT32 },
+        { "MemPoolSize", CT_UINT32 },
+        { "MemPoolFees", CT_INT64 },
+        { "MemPoolValue", CT_INT64 },
+        { "ExpiredCount", CT_UINT32 },
+        { "ExpiredSize", CT_UINT64 },
+        { "ExpiredFees", CT_INT64 },
+        { "EvictedCount", CT_UINT32 },
+        { "EvictedSize", CT_UINT64 },
+        { "EvictedFees", CT_INT64 },
+        { "ReplacedCount", CT_UINT32 },
+        { "MinFeeRate", CT_FLOAT },
+        { "BlockMinFeeRate", CT_FLOAT },
+        { "MemPoolBytesAboveBlockMin", CT_UINT64 },
+        { "MemPoolFeeRateP10", CT_FLOAT },
+        { "MemPoolFeeRateP50", CT_FLOAT },
+        { "MemPoolFeeRateP90", CT_FLOAT },
+        { "MemPoolMedianAge", CT_UINT32 },
+        { "MemPoolOldestAge", CT_UINT32 },
     };
 
-    typedef std::vector< BlockInfo > BlockInfoVector;
-
     class BlockChainImpl : public BlockChain, public UserAllocated
     {
     public:
-        BlockChainImpl(const SimulationSettings &s) : mSimulationSettings(s)
+        BlockChainImpl(const SimulationSettings &s, uint32_t startTime, const Rand &random, bool report) : mRandom(random), mSimulationSettings(s)
         {
             mBlockFees = 0;
             mBlockValue = 0;
-            mBlockChainReport = fopen("BlockChain.csv", "wb");
+            mReport = report;
+            uint32_t format = report ? s.getReportFormat() : 0;
+            mBlockChainReport = (format & RF_CSV) ? ReportWriter::create("BlockChain.csv", s.getReportFlushInterval()) : nullptr;
+            mBlockColumns = (format & RF_BINARY) ? ColumnWriter::create("BlockChain.bcol", gBlockColumns, sizeof(gBlockColumns) / sizeof(gBlockColumns[0])) : nullptr;
             if (mBlockChainReport)
             {
-                fprintf(mBlockChainReport, "Time,BlockTime,BlockSize,TPS,TransactionCount,BlockValue,BlockFees,MemPoolCount,MemPoolSize,MemPoolFees,MemPoolValue\r\n");
-                fflush(mBlockChainReport);
+                mBlockChainReport->addText("Time,BlockTime,BlockSize,TPS,TransactionCount,BlockValue,BlockFees,MemPoolCount,MemPoolSize,MemPoolFees,MemPoolValue,ExpiredCount,ExpiredSize,ExpiredFees,EvictedCount,EvictedSize,EvictedFees,ReplacedCount,MinFeeRate,BlockMinFeeRate,MemPoolBytesAboveBlockMin,MemPoolFeeRateP10,MemPoolFeeRateP50,MemPoolFeeRateP90,MemPoolMedianAge,MemPoolOldestAge\r\n");
             }
-            mMemPool = MemPool::create();
-            mPopulation = Population::create();
-            time_t t;
-            time(&t);
-            mStartTime = uint32_t(t);
+            mMemPool = MemPool::create(mSimulationSettings.getMemPoolType(), mSimulationSettings.getMemPoolExpiry(), mSimulationSettings.getMemPoolMaxSize(), mSimulationSettings.getMemPoolShards());
+            mExpiredCount = 0;
+            mExpiredSize = 0;
+            mExpiredFees = 0;
+            mEvictedCount = 0;
+            mEvictedSize = 0;
+            mEvictedFees = 0;
+            mReplacedCount = 0;
+            // The settings are shared between simulation instances, so every copy is reseeded
+            // with a sub-stream of this instance's own generator before it is sampled.
+            // each cohort takes its sub-streams in file order and hands out every count'th transaction ID
+            uint32_t populationCount = mSimulationSettings.getPopulationCount();
+            for (uint32_t i = 0; i < populationCount; i++)
+            {
+                Population *p = Population::create(mRandom, mSimulationSettings.getPopulation(i), startTime, i, populationCount);
+                if (p)
+                {
+                    mPopulations.push_back(p);
+                }
+            }
+            mStartTime = startTime;
             mBlockCount = 10000;
             mSimulationTime = mStartTime;
             mBlockTime = mSimulationSettings.getBlockTime();
+            mBlockTime.srand(mRandom);
             Gauss g = mSimulationSettings.getMaxBlockSize();
+            g.srand(mRandom);
             mMaxBlockSize = uint32_t(g.Get());
             g = mSimulationSettings.getBlockCount();
+            g.srand(mRandom);
             mBlockCount = uint32_t(g.Get());
             mTransactionSize = mSimulationSettings.getTransactionSize();
+            mTransactionSize.srand(mRandom);
             getNextBlockTime();
+            // Monte Carlo runs already keep every core busy with whole simulations, so only a reported
+            // run moves its cohorts onto producer threads, one each
+            mIngest = nullptr;
+            if (mReport && mSimulationSettings.getIngestQueueSize())
+            {
+                // generate up to about two blocks ahead while the mempool is busy with the current one
+                mIngest = TransactionIngest::create(mSimulationSettings.getIngestQueueSize(), uint32_t(2.0f * mBlockTime.GetMean()));
+                for (auto &p : mPopulations)
+                {
+                    mIngest->addProducer(p, mSimulationTime + 1);
+                }
+            }
+            else
+            {
+                mEvents.schedule(getNextActiveTime(mSimulationTime + 1), ET_TRANSACTION_ARRIVAL);
+            }
         }
 
         virtual ~BlockChainImpl(void)
         {
             if (mBlockChainReport)
             {
-                fclose(mBlockChainReport);
+                mBlockChainReport->release();
+            }
+            if (mBlockColumns)
+            {
+                mBlockColumns->release();
+            }
+            // stop the producer threads before the populations they pump go away
+            if (mIngest)
+            {
+                mIngest->release();
             }
             if (mMemPool)
             {
                 mMemPool->release();
             }
-            if (mPopulation)
+            for (auto &p : mPopulations)
             {
-                mPopulation->release();
+                p->release();
             }
         }
 
@@ -83,56 +148,179 @@ namespace blockchainsim
         {
             bool ret = false;
 
-            // Simulate one second of time passing
-            if (mSecondsRemaining)
+            // Jump straight to the next scheduled event
+            Event e;
+            if (mEvents.next(e))
             {
-                mSimulationTime++;
-                mSecondsRemaining--;
+                mSimulationTime = e.mTime;
+                // everything the producer generated up to now reaches the mempool before it is expired or mined
+                if (mIngest)
+                {
+                    mIngest->drain(mSimulationTime, mMemPool);
+                }
+                switch (e.mType)
+                {
+                    case ET_TRANSACTION_ARRIVAL:
+                        // in cohort order, as the ingest queue merges them; a cohort with nothing due this second generates nothing
+                        for (auto &p : mPopulations)
+                        {
+                            p->pump(mSimulationTime, mMemPool);
+                        }
+                        mEvents.schedule(getNextActiveTime(mSimulationTime + 1), ET_TRANSACTION_ARRIVAL);
+                        ret = true;
+                        break;
+                    case ET_BLOCK_FOUND:
+                        ret = processBlockFound();
+                        break;
+                    case ET_MEMPOOL_EXPIRY:
+                        mMemPool->pump(mSimulationTime);
+                        ret = true;
+                        break;
+                }
+            }
+            return ret;
+        }
 
-                mPopulation->pump(mSimulationTime, mMemPool);
+        bool processBlockFound(void)
+        {
+            bool ret = false;
 
-                ret = true;
-            }
-            else
+            if (mBlockCount)    // if we are still processing blocks....
             {
-                if (mBlockCount)    // if we are still processing blocks....
+                uint32_t transactionCount = 0;
+                uint32_t blockSize = processTransactions(transactionCount);
+                mCurrentBlock.mTimeStamp = mSimulationTime;
+                mCurrentBlock.mBlockTime = mBlockGenerationTime;
+                mCurrentBlock.mTransactionCount = transactionCount;
+                mCurrentBlock.mBlockSize = blockSize;
+                mCurrentBlock.mBlockValue = mBlockValue;
+                mCurrentBlock.mBlockFees = mBlockFees;
+                mCurrentBlock.mMemPoolCount = mMemPool->getMemPoolCount();
+                mCurrentBlock.mMemPoolSize = mMemPool->getMemPoolSize();
+                mCurrentBlock.mMemPoolValue = mMemPool->getMemPoolTotalValue();
+                mCurrentBlock.mMemPoolFees = mMemPool->getMemPoolTotalFees();
+                // The mempool keeps running totals; each block reports what expired since the last one
+                mCurrentBlock.mExpiredCount = mMemPool->getExpiredCount() - mExpiredCount;
+                mCurrentBlock.mExpiredSize = mMemPool->getExpiredSize() - mExpiredSize;
+                mCurrentBlock.mExpiredFees = mMemPool->getExpiredFees() - mExpiredFees;
+                mExpiredCount = mMemPool->getExpiredCount();
+                mExpiredSize = mMemPool->getExpiredSize();
+                mExpiredFees = mMemPool->getExpiredFees();
+                mCurrentBlock.mEvictedCount = mMemPool->getEvictedCount() - mEvictedCount;
+                mCurrentBlock.mEvictedSize = mMemPool->getEvictedSize() - mEvictedSize;
+                mCurrentBlock.mEvictedFees = mMemPool->getEvictedFees() - mEvictedFees;
+                mEvictedCount = mMemPool->getEvictedCount();
+                mEvictedSize = mMemPool->getEvictedSize();
+                mEvictedFees = mMemPool->getEvictedFees();
+                mCurrentBlock.mReplacedCount = mMemPool->getReplacedCount() - mReplacedCount;
+                mReplacedCount = mMemPool->getReplacedCount();
+                mCurrentBlock.mMinFeeRate = mMemPool->getMinFeeRate(mSimulationTime);
+                mCurrentBlock.mBlockMinFeeRate = mBlockTemplate.mMinFeeRate;
+                // A full pass over the mempool, so only taken when the block is reported
+                if (mReport)
                 {
-                    uint32_t transactionCount = 0;
-                    uint32_t blockSize = processTransactions(transactionCount);
-                    mBlocks.push_back(mCurrentBlock);
-                    uint32_t blockNumber = uint32_t(mBlocks.size());
-                    float dtime = float(mBlockGenerationTime) / 60.0f;
-                    char temp[512];
-                    stringFormat(temp, "%0.2f", dtime);
-                    logMessage("Mined block %6s took %5s minutes on %s : Size: %s : TransactionCount: %d\n", formatNumber(blockNumber), temp, getTimeString(mSimulationTime), formatNumber(blockSize), formatNumber(transactionCount));
-                    mCurrentBlock.mTimeStamp = mSimulationTime;
-                    mBlockCount--;
-                    if (mBlockChainReport)
-                    {
-                        fprintf(mBlockChainReport, "%s,", getTimeString(mSimulationTime));
-                        fprintf(mBlockChainReport, "%f,", float(mBlockGenerationTime) / 60.0f);
-                        fprintf(mBlockChainReport, "%d,", blockSize);
-
-                        double tps = double(transactionCount) / double(mBlockGenerationTime);
-                        fprintf(mBlockChainReport, "%f,", tps);
-                        fprintf(mBlockChainReport, "%d,", transactionCount);
-                        fprintf(mBlockChainReport, "%f,", mBlockValue);
-                        fprintf(mBlockChainReport, "%f,", mBlockFees);
-                        fprintf(mBlockChainReport, "%d,", mMemPool->getMemPoolCount());
-                        fprintf(mBlockChainReport, "%d,", mMemPool->getMemPoolSize());
-                        fprintf(mBlockChainReport, "%f,", mMemPool->getMemPoolTotalFees());
-                        fprintf(mBlockChainReport, "%f,", mMemPool->getMemPoolTotalValue());
-                        fprintf(mBlockChainReport, "\r\n");
-                        fflush(mBlockChainReport);
-                    }
-                    mMemPool->pump(mSimulationTime);
-                    getNextBlockTime();
-                    ret = true;
+                    mMemPool->getSnapshot(mSimulationTime, mBlockTemplate.mMinFeeRate, mSnapshot);
+                    mCurrentBlock.mMemPoolBytesAboveBlockMin = mSnapshot.mBytesAboveCutoff;
+                    mCurrentBlock.mMemPoolFeeRateP10 = mSnapshot.mFeeRateP10;
+                    mCurrentBlock.mMemPoolFeeRateP50 = mSnapshot.mFeeRateP50;
+                    mCurrentBlock.mMemPoolFeeRateP90 = mSnapshot.mFeeRateP90;
+                    mCurrentBlock.mMemPoolMedianAge = mSnapshot.mMedianAge;
+                    mCurrentBlock.mMemPoolOldestAge = mSnapshot.mOldestAge;
                 }
+                mBlocks.push_back(mCurrentBlock);
+                mBlockCount--;
+                if (mReport)
+                {
+                    reportBlock(mCurrentBlock);
+                }
+                getNextBlockTime();
+                ret = true;
             }
             return ret;
         }
 
+        void reportBlock(const BlockInfo &b)
+        {
+            uint32_t blockNumber = uint32_t(mBlocks.size());
+            float dtime = float(b.mBlockTime) / 60.0f;
+            char temp[512];
+            stringFormat(temp, "%0.2f", dtime);
+            char timeString[TIME_STRING_SIZE];
+            mTimeFormat.formatTime(b.mTimeStamp, timeString);
+            char blockText[FORMAT_NUMBER_SIZE];
+            char sizeText[FORMAT_NUMBER_SIZE];
+            char countText[FORMAT_NUMBER_SIZE];
+            logMessage(LL_PROGRESS, "Mined block %6s took %5s minutes on %s : Size: %s : TransactionCount: %s\n", formatUnsignedNumber(blockNumber, blockText), temp, timeString, formatUnsignedNumber(b.mBlockSize, sizeText), formatUnsignedNumber(b.mTransactionCount, countText));
+            if (mBlockChainReport)
+            {
+                mBlockChainReport->addString(timeString);
+                mBlockChainReport->addFloat(float(b.mBlockTime) / 60.0f);
+                mBlockChainReport->addUnsigned(b.mBlockSize);
+
+                double tps = double(b.mTransactionCount) / double(b.mBlockTime);
+                mBlockChainReport->addFloat(tps);
+                mBlockChainReport->addUnsigned(b.mTransactionCount);
+                mBlockChainReport->addBitcoin(b.mBlockValue);
+                mBlockChainReport->addBitcoin(b.mBlockFees);
+                mBlockChainReport->addUnsigned(b.mMemPoolCount);
+                mBlockChainReport->addUnsigned(b.mMemPoolSize);
+                mBlockChainReport->addBitcoin(b.mMemPoolFees);
+                mBlockChainReport->addBitcoin(b.mMemPoolValue);
+                mBlockChainReport->addUnsigned(b.mExpiredCount);
+                mBlockChainReport->addUnsigned(b.mExpiredSize);
+                mBlockChainReport->addBitcoin(b.mExpiredFees);
+                mBlockChainReport->addUnsigned(b.mEvictedCount);
+                mBlockChainReport->addUnsigned(b.mEvictedSize);
+                mBlockChainReport->addBitcoin(b.mEvictedFees);
+                mBlockChainReport->addUnsigned(b.mReplacedCount);
+                mBlockChainReport->addFloat(b.mMinFeeRate);
+                mBlockChainReport->addFloat(b.mBlockMinFeeRate);
+                mBlockChainReport->addUnsigned(b.mMemPoolBytesAboveBlockMin);
+                mBlockChainReport->addFloat(b.mMemPoolFeeRateP10);
+                mBlockChainReport->addFloat(b.mMemPoolFeeRateP50);
+                mBlockChainReport->addFloat(b.mMemPoolFeeRateP90);
+                mBlockChainReport->addUnsigned(b.mMemPoolMedianAge);
+                mBlockChainReport->addUnsigned(b.mMemPoolOldestAge);
+                mBlockChainReport->endRow();
+            }
+            if (mBlockColumns)
+            {
+                mBlockColumns->addUInt32(b.mTimeStamp);
+                mBlockColumns->addFloat(float(b.mBlockTime) / 60.0f);
+                mBlockColumns->addUInt32(b.mBlockSize);
+                mBlockColumns->addDouble(double(b.mTransactionCount) / double(b.mBlockTime));
+                mBlockColumns->addUInt32(b.mTransactionCount);
+                mBlockColumns->addInt64(b.mBlockValue);
+                mBlockColumns->addInt64(b.mBlockFees);
+                mBlockColumns->addUInt32(b.mMemPoolCount);
+                mBlockColumns->addUInt32(b.mMemPoolSize);
+                mBlockColumns->addInt64(b.mMemPoolFees);
+                mBlockColumns->addInt64(b.mMemPoolValue);
+                mBlockColumns->addUInt32(b.mExpiredCount);
+                mBlockColumns->addUInt64(b.mExpiredSize);
+                mBlockColumns->addInt64(b.mExpiredFees);
+                mBlockColumns->addUInt32(b.mEvictedCount);
+                mBlockColumns->addUInt64(b.mEvictedSize);
+                mBlockColumns->addInt64(b.mEvictedFees);
+                mBlockColumns->addUInt32(b.mReplacedCount);
+                mBlockColumns->addFloat(b.mMinFeeRate);
+                mBlockColumns->addFloat(b.mBlockMinFeeRate);
+                mBlockColumns->addUInt64(b.mMemPoolBytesAboveBlockMin);
+                mBlockColumns->addFloat(b.mMemPoolFeeRateP10);
+                mBlockColumns->addFloat(b.mMemPoolFeeRateP50);
+                mBlockColumns->addFloat(b.mMemPoolFeeRateP90);
+                mBlockColumns->addUInt32(b.mMemPoolMedianAge);
+                mBlockColumns->addUInt32(b.mMemPoolOldestAge);
+                mBlockColumns->endRow();
+            }
+        }
+
+        virtual const BlockInfo *getBlocks(uint32_t &count) const final
+        {
+            count = uint32_t(mBlocks.size());
+            return count ? &mBlocks[0] : nullptr;
+        }
+
         virtual void release(void) final
         {
             delete this;
@@ -140,60 +328,80 @@ namespace blockchainsim
 
         uint32_t processTransactions(uint32_t &transactionCount)
         {
-            uint32_t blockSize = 0;
-            transactionCount = 0;
-
-            for (;;)
-            {
-                Transaction t;
-                bool haveWork = mMemPool->peekTransaction(t);
-                if (!haveWork)
-                {
-                    break;
-                }
-                if ((blockSize + t.mTransactionSize) > mMaxBlockSize)
-                {
-                    break;
-                }
-                mMemPool->getTransaction(t);
-                transactionCount++;
-                blockSize += t.mTransactionSize;
-                mBlockFees += t.mFee;
-                mBlockValue += t.mValue;
-            }
-
-            return blockSize;
+            mMemPool->buildBlock(mMaxBlockSize, mBlockTemplate);
+            transactionCount = mBlockTemplate.mTransactionCount;
+            mBlockFees += mBlockTemplate.mBlockFees;
+            mBlockValue += mBlockTemplate.mBlockValue;
+            return mBlockTemplate.mBlockSize;
         }
 
         void getNextBlockTime(void)
         {
             mBlockValue = 0;
             mBlockFees = 0;
-            mBlockGenerationTime = mSecondsRemaining = uint32_t(mBlockTime.Get()); // how many seconds until the next block is discovered!
+            mBlockGenerationTime = uint32_t(mBlockTime.Get()); // how many seconds until the next block is discovered!
+            // Expire stale transactions just before the block is found so they are not mined
+            mEvents.schedule(mSimulationTime + mBlockGenerationTime, ET_MEMPOOL_EXPIRY);
+            mEvents.schedule(mSimulationTime + mBlockGenerationTime, ET_BLOCK_FOUND);
             mCurrentBlock.init();
         }
 
+        // the soonest second any cohort has something to generate
+        uint32_t getNextActiveTime(uint32_t timeStamp) const
+        {
+            uint32_t ret = 0xFFFFFFFF;
+            for (auto &p : mPopulations)
+            {
+                uint32_t t = p->getNextActiveTime(timeStamp);
+                ret = t < ret ? t : ret;
+            }
+            return ret;
+        }
+
+        Rand                        mRandom;                // this instance's random stream; every Gauss draws a sub-stream of it
         BlockInfo                   mCurrentBlock;
-        double                      mBlockValue;
-        double                      mBlockFees;
+        int64_t                     mBlockValue;
+        int64_t                     mBlockFees;
         uint32_t                    mBlockCount;            // how many blocks to simulate mining
         uint32_t                    mStartTime;             // time we started running this simulation...
         uint32_t                    mSimulationTime;        // how many seconds we have been running the simulation
         uint32_t                    mBlockGenerationTime;
-        uint32_t                    mSecondsRemaining;      // how many seconds left to run..
         const SimulationSettings  &mSimulationSettings;
         Gauss                       mBlockTime;
         uint32_t                    mMaxBlockSize;          // maximum block-size in bytes
         Gauss                       mTransactionSize;
         BlockInfoVector             mBlocks;                // simulated mined blocks
-        Population                  *mPopulation;
+        BlockTemplate               mBlockTemplate;         // transactions selected for the block being mined
+        MemPoolSnapshot             mSnapshot;              // mempool statistics after the last block
+        uint32_t                    mExpiredCount;          // mempool expiry totals as of the previous block
+        uint64_t                    mExpiredSize;
+        int64_t                     mExpiredFees;
+        uint32_t                    mEvictedCount;          // mempool eviction totals as of the previous block
+        uint64_t                    mEvictedSize;
+        int64_t                     mEvictedFees;
+        uint32_t                    mReplacedCount;         // mempool replacement total as of the previous block
+        EventQueue                  mEvents;                // pending simulation events in time order
+        PopulationVector            mPopulations;
+        TransactionIngest           *mIngest;               // carries transactions from the population's thread; null when it is pumped inline
         MemPool                     *mMemPool;
-        FILE                        *mBlockChainReport;
+        bool                        mReport;                // log and write BlockChain.csv for every block
+        ReportWriter                *mBlockChainReport;
+        ColumnWriter                *mBlockColumns;         // the same rows as mBlockChainReport, as a binary column file
+        TimeFormatter               mTimeFormat;
     };
 
     BlockChain * BlockChain::create(const SimulationSettings &s)
     {
-        BlockChainImpl *b = NV_NEW(BlockChainImpl)(s);
+        time_t t;
+        time(&t);
+        Rand random;
+        random.setSeed(SIMULATION_SEED, 0);
+        return create(s, uint32_t(t), random, true);
+    }
+
+    BlockChain * BlockChain::create(const SimulationSettings &s, uint32_t startTime, const Rand &random, bool report)
+    {
+        BlockChainImpl *b = NV_NEW(BlockChainImpl)(s, startTime, random, report);
         return static_cast<BlockChain *>(b);
     }
 }
@@ -1,18 +1,99 @@
 #ifndef BLOCKCHAIN_H
 #define BLOCKCHAIN_H
 
+#include <stdint.h>
+
 namespace blockchainsim
 {
 
 
 class SimulationSettings;
+class Rand;
+
+// Every simulation instance draws from a stream of this one seed, so results are reproducible
+#define SIMULATION_SEED 0x626C6F636B636861ULL
+
+// Statistics recorded for every simulated block
+class BlockInfo
+{
+public:
+    BlockInfo(void)
+    {
+        init();
+    }
+    void init(void)
+    {
+        mTimeStamp = 0;
+        mBlockTime = 0;
+        mTransactionCount = 0;
+        mBlockSize = 0;
+        mBlockValue = 0;
+        mBlockFees = 0;
+        mMemPoolCount = 0;
+        mMemPoolSize = 0;
+        mMemPoolValue = 0;
+        mMemPoolFees = 0;
+        mExpiredCount = 0;
+        mExpiredSize = 0;
+        mExpiredFees = 0;
+        mEvictedCount = 0;
+        mEvictedSize = 0;
+        mEvictedFees = 0;
+        mReplacedCount = 0;
+        mMinFeeRate = 0;
+        mBlockMinFeeRate = 0;
+        mMemPoolBytesAboveBlockMin = 0;
+        mMemPoolFeeRateP10 = 0;
+        mMemPoolFeeRateP50 = 0;
+        mMemPoolFeeRateP90 = 0;
+        mMemPoolMedianAge = 0;
+        mMemPoolOldestAge = 0;
+    }
+    uint32_t    mTimeStamp;             // time stamp for this block
+    uint32_t    mBlockTime;             // how many seconds it took to find this block
+    uint32_t    mTransactionCount;      // how many transactions are in this block
+    uint32_t    mBlockSize;             // size of the block
+    // amounts are in satoshis
+    int64_t     mBlockValue;            // total value of the transactions in this block
+    int64_t     mBlockFees;             // total fees of the transactions in this block
+    uint32_t    mMemPoolCount;          // transactions left in the mempool after this block
+    uint32_t    mMemPoolSize;           // bytes left in the mempool after this block
+    int64_t     mMemPoolValue;          // value left in the mempool after this block
+    int64_t     mMemPoolFees;           // fees left in the mempool after this block
+    uint32_t    mExpiredCount;          // transactions dropped from the mempool since the previous block
+    uint64_t    mExpiredSize;           // bytes dropped from the mempool since the previous block
+    int64_t     mExpiredFees;           // fees dropped from the mempool since the previous block
+    uint32_t    mEvictedCount;          // transactions evicted or turned away by a full mempool since the previous block
+    uint64_t    mEvictedSize;           // bytes evicted or turned away since the previous block
+    int64_t     mEvictedFees;           // fees evicted or turned away since the previous block
+    uint32_t    mReplacedCount;         // pending transactions replaced by a higher fee since the previous block
+    float       mMinFeeRate;            // satoshis per byte needed to enter the mempool after this block
+    float       mBlockMinFeeRate;       // lowest fee rate mined into this block
+    uint64_t    mMemPoolBytesAboveBlockMin; // bytes left in the mempool that pay at least mBlockMinFeeRate
+    float       mMemPoolFeeRateP10;     // fee rate percentiles of the mempool after this block
+    float       mMemPoolFeeRateP50;
+    float       mMemPoolFeeRateP90;
+    uint32_t    mMemPoolMedianAge;      // seconds the median transaction left in the mempool has waited
+    uint32_t    mMemPoolOldestAge;      // seconds the oldest transaction left in the mempool has waited
+};
 
 class BlockChain
 {
 public:
 	static BlockChain *create(const SimulationSettings &s);
+
+	// Create an isolated simulation instance that draws every random number from a copy of 'random'.
+	// Give each instance its own stream by seeding one generator with SIMULATION_SEED and longJumping
+	// it between instances.  If 'report' is false nothing is logged or written to BlockChain.csv and
+	// results are only available via getBlocks
+	static BlockChain *create(const SimulationSettings &s, uint32_t startTime, const Rand &random, bool report);
+
     // pump loop of the blockchain simulation; returns true if the simulation is still running; false if it is complete
     virtual bool pump(void) = 0;
+
+    // returns the statistics of every block mined so far
+    virtual const BlockInfo *getBlocks(uint32_t &count) const = 0;
+
 	virtual void release(void) = 0;
 protected:
 	virtual ~BlockChain(void)
@@ -0,0 +1,308 @@
+#include "ColumnFile.h"
+#include "MappedFile.h"
+#include "NsUserAllocated.h"
+#include "NvAssert.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <string>
+
+#pragma warning(disable:4996)
+#pragma warning(disable:4100)
+
+namespace blockchainsim
+{
+
+    #define COLUMN_FILE_ALIGNMENT 4096      // the first chunk starts on a page boundary
+
+    typedef std::vector< uint8_t > ByteVector;
+    typedef std::vector< uint64_t > OffsetVector;
+    typedef std::vector< ColumnType > ColumnTypeVector;
+    typedef std::vector< uint32_t > WidthVector;
+    typedef std::vector< std::string > StringVector;
+
+    static uint32_t getTypeWidth(ColumnType type)
+    {
+        return (type == CT_UINT32 || type == CT_FLOAT) ? 4 : 8;
+    }
+
+    class ColumnWriterImpl : public ColumnWriter, public UserAllocated
+    {
+    public:
+        ColumnWriterImpl(FILE *fph, const ColumnDesc *columns, uint32_t columnCount, uint32_t rowsPerChunk)
+        {
+            mFile = fph;
+            mRowsPerChunk = rowsPerChunk ? rowsPerChunk : COLUMN_ROWS_PER_CHUNK;
+            mRow = 0;
+            mColumn = 0;
+            memset(&mHeader, 0, sizeof(mHeader));
+            mHeader.mMagic = COLUMN_FILE_MAGIC;
+            mHeader.mVersion = COLUMN_FILE_VERSION;
+            mHeader.mColumnCount = columnCount;
+            mHeader.mRowsPerChunk = mRowsPerChunk;
+            // Each column's slice of a chunk follows the one before it
+            uint64_t chunkSize = 0;
+            for (uint32_t i = 0; i < columnCount; i++)
+            {
+                mTypes.push_back(columns[i].mType);
+                mWidths.push_back(getTypeWidth(columns[i].mType));
+                mOffsets.push_back(chunkSize);
+                chunkSize += uint64_t(mWidths[i]) * mRowsPerChunk;
+            }
+            uint64_t descSize = sizeof(ColumnFileHeader) + sizeof(ColumnFileColumn) * columnCount;
+            mHeader.mDataOffset = (descSize + COLUMN_FILE_ALIGNMENT - 1) & ~uint64_t(COLUMN_FILE_ALIGNMENT - 1);
+            mHeader.mChunkSize = chunkSize;
+            mChunk.resize(size_t(chunkSize));
+            // The row count is filled in when the file is closed
+            ByteVector prefix(size_t(mHeader.mDataOffset));
+            memcpy(&prefix[0], &mHeader, sizeof(mHeader));
+            for (uint32_t i = 0; i < columnCount; i++)
+            {
+                ColumnFileColumn c;
+                memset(&c, 0, sizeof(c));
+                strncpy(c.mName, columns[i].mName, COLUMN_NAME_SIZE - 1);
+                c.mType = uint32_t(columns[i].mType);
+                c.mWidth = mWidths[i];
+                memcpy(&prefix[sizeof(ColumnFileHeader) + sizeof(ColumnFileColumn) * i], &c, sizeof(c));
+            }
+            fwrite(&prefix[0], 1, prefix.size(), mFile);
+        }
+
+        virtual ~ColumnWriterImpl(void)
+        {
+            NV_ASSERT(mColumn == 0);
+            if (mRow)
+            {
+                writeChunk();
+            }
+            fseek(mFile, 0, SEEK_SET);
+            fwrite(&mHeader, 1, sizeof(mHeader), mFile);
+            fclose(mFile);
+        }
+
+        virtual void addUInt32(uint32_t v) final
+        {
+            set(CT_UINT32, &v);
+        }
+
+        virtual void addUInt64(uint64_t v) final
+        {
+            set(CT_UINT64, &v);
+        }
+
+        virtual void addInt64(int64_t v) final
+        {
+            set(CT_INT64, &v);
+        }
+
+        virtual void addFloat(float v) final
+        {
+            set(CT_FLOAT, &v);
+        }
+
+        virtual void addDouble(double v) final
+        {
+            set(CT_DOUBLE, &v);
+        }
+
+        virtual void endRow(void) final
+        {
+            NV_ASSERT(mColumn == mHeader.mColumnCount);
+            mColumn = 0;
+            mRow++;
+            mHeader.mRowCount++;
+            if (mRow == mRowsPerChunk)
+            {
+                writeChunk();
+            }
+        }
+
+        virtual void release(void) final
+        {
+            delete this;
+        }
+
+    private:
+        void set(ColumnType type, const void *v)
+        {
+            NV_ASSERT(mColumn < mHeader.mColumnCount && mTypes[mColumn] == type);
+            memcpy(&mChunk[size_t(mOffsets[mColumn] + uint64_t(mRow) * mWidths[mColumn])], v, mWidths[mColumn]);
+            mColumn++;
+        }
+
+        // cleared once written, so the unused rows of a partly filled last chunk are zeros
+        void writeChunk(void)
+        {
+            fwrite(&mChunk[0], 1, mChunk.size(), mFile);
+            memset(&mChunk[0], 0, mChunk.size());
+            mRow = 0;
+        }
+
+        FILE                *mFile;
+        ColumnFileHeader    mHeader;
+        uint32_t            mRowsPerChunk;
+        uint32_t            mRow;                   // row being set within the chunk
+        uint32_t            mColumn;                // next column to be set
+        ColumnTypeVector    mTypes;
+        WidthVector         mWidths;
+        OffsetVector        mOffsets;               // where each column starts within a chunk
+        ByteVector          mChunk;
+    };
+
+    ColumnWriter *ColumnWriter::create(const char *fname, const ColumnDesc *columns, uint32_t columnCount, uint32_t rowsPerChunk)
+    {
+        FILE *fph = fopen(fname, "wb");
+        if (!fph)
+        {
+            return nullptr;
+        }
+        ColumnWriterImpl *w = NV_NEW(ColumnWriterImpl)(fph, columns, columnCount, rowsPerChunk);
+        return static_cast<ColumnWriter *>(w);
+    }
+
+    class ColumnReaderImpl : public ColumnReader, public UserAllocated
+    {
+    public:
+        ColumnReaderImpl(MappedFile *file)
+        {
+            mFile = file;
+            mColumns = reinterpret_cast<const ColumnFileColumn *>(mFile->getData() + sizeof(ColumnFileHeader));
+            mChunkCount = 0;
+            memset(&mHeader, 0, sizeof(mHeader));
+        }
+
+        virtual ~ColumnReaderImpl(void)
+        {
+            mFile->release();
+        }
+
+        // Reads the schema; false unless everything the header promises is inside the file
+        bool init(void)
+        {
+            if (mFile->getSize() < sizeof(ColumnFileHeader))
+            {
+                return false;
+            }
+            memcpy(&mHeader, mFile->getData(), sizeof(mHeader));
+            if (mHeader.mMagic != COLUMN_FILE_MAGIC || mHeader.mVersion != COLUMN_FILE_VERSION || mHeader.mRowsPerChunk == 0)
+            {
+                return false;
+            }
+            uint64_t descSize = sizeof(ColumnFileHeader) + sizeof(ColumnFileColumn) * uint64_t(mHeader.mColumnCount);
+            if (descSize > mHeader.mDataOffset || mHeader.mDataOffset > mFile->getSize())
+            {
+                return false;
+            }
+            uint64_t chunkSize = 0;
+            for (uint32_t i = 0; i < mHeader.mColumnCount; i++)
+            {
+                const ColumnFileColumn &c = mColumns[i];
+                if (c.mType > CT_DOUBLE || c.mWidth != getTypeWidth(ColumnType(c.mType)))
+                {
+                    return false;
+                }
+                mOffsets.push_back(chunkSize);
+                chunkSize += uint64_t(c.mWidth) * mHeader.mRowsPerChunk;
+                // a name that fills its whole field has no terminator
+                size_t len = 0;
+                while (len < COLUMN_NAME_SIZE && c.mName[len])
+                {
+                    len++;
+                }
+                mNames.push_back(std::string(c.mName, len));
+            }
+            uint64_t chunkCount = (mHeader.mRowCount + mHeader.mRowsPerChunk - 1) / mHeader.mRowsPerChunk;
+            if (chunkSize != mHeader.mChunkSize || (chunkSize && (mFile->getSize() - mHeader.mDataOffset) / chunkSize < chunkCount))
+            {
+                return false;
+            }
+            mChunkCount = uint32_t(chunkCount);
+            return true;
+        }
+
+        virtual uint64_t getRowCount(void) const final
+        {
+            return mHeader.mRowCount;
+        }
+
+        virtual uint32_t getColumnCount(void) const final
+        {
+            return mHeader.mColumnCount;
+        }
+
+        virtual const char *getColumnName(uint32_t column) const final
+        {
+            return mNames[column].c_str();
+        }
+
+        virtual ColumnType getColumnType(uint32_t column) const final
+        {
+            return ColumnType(mColumns[column].mType);
+        }
+
+        virtual uint32_t getColumnWidth(uint32_t column) const final
+        {
+            return mColumns[column].mWidth;
+        }
+
+        virtual uint32_t findColumn(const char *name) const final
+        {
+            for (uint32_t i = 0; i < mHeader.mColumnCount; i++)
+            {
+                if (mNames[i] == name)
+                {
+                    return i;
+                }
+            }
+            return COLUMN_NOT_FOUND;
+        }
+
+        virtual uint32_t getChunkCount(void) const final
+        {
+            return mChunkCount;
+        }
+
+        virtual uint32_t getRowsPerChunk(void) const final
+        {
+            return mHeader.mRowsPerChunk;
+        }
+
+        virtual const void *getColumn(uint32_t column, uint32_t chunk, uint32_t &count) const final
+        {
+            uint64_t first = uint64_t(chunk) * mHeader.mRowsPerChunk;
+            uint64_t left = mHeader.mRowCount - first;
+            count = uint32_t(left < mHeader.mRowsPerChunk ? left : mHeader.mRowsPerChunk);
+            return mFile->getData() + mHeader.mDataOffset + uint64_t(chunk) * mHeader.mChunkSize + mOffsets[column];
+        }
+
+        virtual void release(void) final
+        {
+            delete this;
+        }
+
+    private:
+        MappedFile                  *mFile;
+        ColumnFileHeader            mHeader;
+        const ColumnFileColumn      *mColumns;
+        uint32_t                    mChunkCount;
+        OffsetVector                mOffsets;       // where each column starts within a chunk
+        StringVector                mNames;
+    };
+
+    ColumnReader *ColumnReader::create(const char *fname)
+    {
+        MappedFile *file = MappedFile::create(fname);
+        if (!file)
+        {
+            return nullptr;
+        }
+        ColumnReaderImpl *r = NV_NEW(ColumnReaderImpl)(file);
+        if (!r->init())
+        {
+            r->release();
+            return nullptr;
+        }
+        return static_cast<ColumnReader *>(r);
+    }
+
+} // end of blockchainsim namespace
@@ -0,0 +1,133 @@
+#ifndef COLUMN_FILE_H
+#define COLUMN_FILE_H
+
+// A binary, column oriented table for per-block results.  Nothing is printed or parsed: every
+// value is stored in its native little-endian form, so a reader maps the file and uses each
+// column in place as an array.
+//
+// The file is a header, one descriptor per column, then a run of equally sized chunks starting on
+// a page boundary.  A chunk holds the next 'rowsPerChunk' rows stored column after column, so
+// within a chunk every column is one contiguous array.  The last chunk is padded out to full size;
+// the row count in the header says how much of it is real.
+
+#include <stdint.h>
+
+namespace blockchainsim
+{
+
+    #define COLUMN_FILE_MAGIC 0x4C4F4342        // 'BCOL'
+    #define COLUMN_FILE_VERSION 1
+    #define COLUMN_NAME_SIZE 40
+    #define COLUMN_ROWS_PER_CHUNK 4096
+    #define COLUMN_NOT_FOUND 0xFFFFFFFF
+
+    enum ColumnType
+    {
+        CT_UINT32,
+        CT_UINT64,
+        CT_INT64,
+        CT_FLOAT,
+        CT_DOUBLE,
+    };
+
+    class ColumnFileHeader
+    {
+    public:
+        uint32_t    mMagic;
+        uint32_t    mVersion;
+        uint32_t    mColumnCount;
+        uint32_t    mRowsPerChunk;
+        uint64_t    mRowCount;
+        uint64_t    mDataOffset;                // where the first chunk starts
+        uint64_t    mChunkSize;                 // bytes in every chunk
+        uint8_t     mReserved[24];
+    };
+
+    class ColumnFileColumn
+    {
+    public:
+        char        mName[COLUMN_NAME_SIZE];
+        uint32_t    mType;                      // a ColumnType
+        uint32_t    mWidth;                     // bytes per value
+    };
+
+    static_assert(sizeof(ColumnFileHeader) == 64, "ColumnFileHeader is part of the file format");
+    static_assert(sizeof(ColumnFileColumn) == 48, "ColumnFileColumn is part of the file format");
+
+    // one column of the table being written
+    class ColumnDesc
+    {
+    public:
+        const char  *mName;
+        ColumnType  mType;
+    };
+
+    class ColumnWriter
+    {
+    public:
+        // returns nullptr if 'fname' cannot be created
+        static ColumnWriter *create(const char *fname, const ColumnDesc *columns, uint32_t columnCount, uint32_t rowsPerChunk = COLUMN_ROWS_PER_CHUNK);
+
+        // Each of these sets the next column of the current row, which must be of the matching type
+        virtual void addUInt32(uint32_t v) = 0;
+        virtual void addUInt64(uint64_t v) = 0;
+        virtual void addInt64(int64_t v) = 0;
+        virtual void addFloat(float v) = 0;
+        virtual void addDouble(double v) = 0;
+
+        // every column has been set; a full chunk is written out
+        virtual void endRow(void) = 0;
+
+        // writes the last chunk, records the row count and closes the file
+        virtual void release(void) = 0;
+    protected:
+        virtual ~ColumnWriter(void)
+        {
+        }
+    };
+
+    class ColumnReader
+    {
+    public:
+        // returns nullptr if 'fname' cannot be mapped or is not a column file
+        static ColumnReader *create(const char *fname);
+
+        virtual uint64_t getRowCount(void) const = 0;
+
+        virtual uint32_t getColumnCount(void) const = 0;
+
+        virtual const char *getColumnName(uint32_t column) const = 0;
+
+        virtual ColumnType getColumnType(uint32_t column) const = 0;
+
+        // bytes per value
+        virtual uint32_t getColumnWidth(uint32_t column) const = 0;
+
+        // COLUMN_NOT_FOUND if there is no column called 'name'
+        virtual uint32_t findColumn(const char *name) const = 0;
+
+        virtual uint32_t getChunkCount(void) const = 0;
+
+        virtual uint32_t getRowsPerChunk(void) const = 0;
+
+        // Where 'column' of 'chunk' starts, and how many rows of it are in use; it holds rows
+        // chunk * rowsPerChunk on.  Use getColumnAs for a typed pointer.
+        virtual const void *getColumn(uint32_t column, uint32_t chunk, uint32_t &count) const = 0;
+
+        // nullptr if 'T' is not the width of the column
+        template< class T > const T *getColumnAs(uint32_t column, uint32_t chunk, uint32_t &count) const
+        {
+            const void *ret = getColumn(column, chunk, count);
+            return getColumnWidth(column) == sizeof(T) ? static_cast<const T *>(ret) : nullptr;
+        }
+
+        virtual void release(void) = 0;
+    protected:
+        virtual ~ColumnReader(void)
+        {
+        }
+    };
+
+} // end of blockchainsim namespace
+
+#endif
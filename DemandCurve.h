@@ -0,0 +1,110 @@
+#ifndef DEMAND_CURVE_H
+#define DEMAND_CURVE_H
+
+// How busy a population is over the week.  An hour-of-week table of rate multipliers (Sunday
+// 00:00 UTC first) is expanded once into a per-minute table, interpolating linearly between the
+// middles of neighboring hours, so the simulation reads the multiplier for any second with one
+// array lookup indexed by the time stamp modulo a week.  A second table holds how many minutes
+// remain until the next busy one, so idle stretches are skipped in one step.
+
+#include <stdint.h>
+
+namespace blockchainsim
+{
+
+    #define DEMAND_HOURS_PER_WEEK (7*24)
+    #define DEMAND_MINUTES_PER_WEEK (7*24*60)
+    #define DEMAND_SECONDS_PER_WEEK (7*24*60*60)
+    #define DEMAND_EPOCH_WEEKDAY 4              // the Unix epoch fell on a Thursday; Sunday is day zero
+    #define DEMAND_NEVER 0xFFFF
+
+    class DemandCurve
+    {
+    public:
+        // The built-in curve: full rate between 08:00 and 12:59 UTC every day, idle otherwise, with no ramps
+        DemandCurve(void)
+        {
+            float hours[DEMAND_HOURS_PER_WEEK];
+            for (uint32_t i = 0; i < DEMAND_HOURS_PER_WEEK; i++)
+            {
+                uint32_t hour = i % 24;
+                hours[i] = (hour >= 8 && hour <= 12) ? 1.0f : 0.0f;
+            }
+            build(hours, false);
+        }
+
+        // 'hours' holds DEMAND_HOURS_PER_WEEK multipliers, Sunday 00:00 UTC first
+        DemandCurve(const float *hours)
+        {
+            build(hours, true);
+        }
+
+        // the rate multiplier in effect at 'timeStamp'; zero when the population is idle
+        float getRate(uint32_t timeStamp) const
+        {
+            return mRates[(timeStamp % DEMAND_SECONDS_PER_WEEK) / 60];
+        }
+
+        // the first second at or after 'timeStamp' with a non-zero rate; 0xFFFFFFFF if the curve is idle all week
+        uint32_t getNextActiveTime(uint32_t timeStamp) const
+        {
+            uint32_t skip = mSkip[(timeStamp % DEMAND_SECONDS_PER_WEEK) / 60];
+            if (skip == 0)
+            {
+                return timeStamp;
+            }
+            if (skip == DEMAND_NEVER)
+            {
+                return 0xFFFFFFFF;
+            }
+            return timeStamp - (timeStamp % 60) + skip * 60;
+        }
+
+    private:
+        void build(const float *hours, bool interpolate)
+        {
+            // Minute zero of the table is the epoch's weekday; hour zero of the input is Sunday's
+            for (uint32_t m = 0; m < DEMAND_MINUTES_PER_WEEK; m++)
+            {
+                uint32_t minute = (m + DEMAND_EPOCH_WEEKDAY * 24 * 60) % DEMAND_MINUTES_PER_WEEK;
+                uint32_t hour = minute / 60;
+                float rate = hours[hour];
+                if (interpolate)
+                {
+                    // position relative to the middle of the hour, in hours
+                    float t = (float(minute % 60) + 0.5f) / 60.0f - 0.5f;
+                    uint32_t other = t < 0 ? (hour + DEMAND_HOURS_PER_WEEK - 1) % DEMAND_HOURS_PER_WEEK : (hour + 1) % DEMAND_HOURS_PER_WEEK;
+                    t = t < 0 ? -t : t;
+                    rate += (hours[other] - rate) * t;
+                }
+                mRates[m] = rate > 0 ? rate : 0;
+            }
+            // Minutes to the next busy minute, wrapping around the end of the week
+            uint32_t next = DEMAND_NEVER;
+            for (uint32_t pass = 0; pass < 2; pass++)
+            {
+                for (uint32_t m = DEMAND_MINUTES_PER_WEEK; m-- != 0;)
+                {
+                    if (mRates[m] > 0)
+                    {
+                        next = m;
+                    }
+                    if (next == DEMAND_NEVER)
+                    {
+                        mSkip[m] = DEMAND_NEVER;
+                    }
+                    else
+                    {
+                        mSkip[m] = uint16_t(next >= m ? next - m : next + DEMAND_MINUTES_PER_WEEK - m);
+                    }
+                }
+            }
+        }
+
+        float       mRates[DEMAND_MINUTES_PER_WEEK];
+        uint16_t    mSkip[DEMAND_MINUTES_PER_WEEK];
+    };
+
+} // end of blockchainsim namespace
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef EVENT_QUEUE_H
+#define EVENT_QUEUE_H
+
+// A small discrete-event queue; events are returned in time order so the simulation
+// can jump directly from one scheduled event to the next instead of ticking every second.
+
+#include <stdint.h>
+#include <vector>
+#include <queue>
+#include <functional>
+
+namespace blockchainsim
+{
+
+    // The order of the event types is significant; when two events are scheduled for the
+    // same second they are processed in this order.
+    enum EventType
+    {
+        ET_TRANSACTION_ARRIVAL,     // the population generates transactions for this second
+        ET_MEMPOOL_EXPIRY,          // the mempool drops transactions that have waited too long
+        ET_BLOCK_FOUND,             // a miner found a block
+    };
+
+    class Event
+    {
+    public:
+        Event(void)
+        {
+            mTime = 0;
+            mType = ET_TRANSACTION_ARRIVAL;
+        }
+
+        Event(uint32_t time, EventType type) : mTime(time), mType(type)
+        {
+        }
+
+        bool operator>(const Event &e) const
+        {
+            if (mTime != e.mTime)
+            {
+                return mTime > e.mTime;
+            }
+            return mType > e.mType;
+        }
+
+        uint32_t    mTime;      // simulation time stamp this event fires at
+        EventType   mType;      // what kind of event this is
+    };
+
+    class EventQueue
+    {
+    public:
+        void schedule(uint32_t time, EventType type)
+        {
+            mEvents.push(Event(time, type));
+        }
+
+        // pop the next event in time order; returns false if nothing is scheduled
+        bool next(Event &e)
+        {
+            bool ret = false;
+            if (!mEvents.empty())
+            {
+                e = mEvents.top();
+                mEvents.pop();
+                ret = true;
+            }
+            return ret;
+        }
+
+        bool empty(void) const
+        {
+            return mEvents.empty();
+        }
+
+    private:
+        std::priority_queue< Event, std::vector< Event >, std::greater< Event > > mEvents;
+    };
+
+} // end of blockchainsim namespace
+
+#endif
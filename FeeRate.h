@@ -0,0 +1,135 @@
+#ifndef FEE_RATE_H
+#define FEE_RATE_H
+
+// Logarithmic fee-rate buckets shared by every mempool implementation so their histograms
+// line up.  Fee rates are in satoshis per byte; each power of two is split into four buckets,
+// so bucket 'b' starts at 2^(b/4) satoshis per byte.
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace blockchainsim
+{
+
+    #define FEE_RATE_BUCKETS 128
+    #define FEE_RATE_BUCKETS_PER_OCTAVE 4
+    #define MIN_FEE_RATE_INCREMENT 1.0f             // satoshis per byte a newcomer must beat an evicted transaction by
+    #define MIN_FEE_RATE_HALF_LIFE (12*60*60)       // seconds for the minimum fee rate to halve once evictions stop
+
+    // satoshis per byte
+    inline float getFeeRate(uint32_t fee, uint32_t transactionSize)
+    {
+        return transactionSize ? float(fee) / float(transactionSize) : 0.0f;
+    }
+
+    // Bucket index read straight from the float's exponent and top two mantissa bits; no libm call
+    // and no branches, so loops over it vectorize.  'feeRate' must not be negative.
+    inline uint32_t getFeeRateBucket(float feeRate)
+    {
+        uint32_t bits;
+        memcpy(&bits, &feeRate, sizeof(bits));
+        int32_t bucket = int32_t(bits >> 21) - 127 * FEE_RATE_BUCKETS_PER_OCTAVE;
+        bucket = bucket < 0 ? 0 : bucket;
+        return bucket < FEE_RATE_BUCKETS ? uint32_t(bucket) : FEE_RATE_BUCKETS - 1;
+    }
+
+    // Lowest fee rate (satoshis per byte) that lands in this bucket
+    inline float getFeeRateBucketFloor(uint32_t bucket)
+    {
+        uint32_t exponent = bucket / FEE_RATE_BUCKETS_PER_OCTAVE;
+        uint32_t bits = ((exponent + 127) << 23) | ((bucket % FEE_RATE_BUCKETS_PER_OCTAVE) << 21);
+        float ret;
+        memcpy(&ret, &bits, sizeof(ret));
+        return ret;
+    }
+
+    // index of the most significant set bit; 'v' must not be zero
+    inline uint32_t getHighestBit(uint64_t v)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, v);
+        return uint32_t(index);
+#else
+        return uint32_t(63 - __builtin_clzll(v));
+#endif
+    }
+
+    // index of the least significant set bit; 'v' must not be zero
+    inline uint32_t getLowestBit(uint64_t v)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, v);
+        return uint32_t(index);
+#else
+        return uint32_t(__builtin_ctzll(v));
+#endif
+    }
+
+    // The fee rate a transaction must pay to enter a full mempool.  Every eviction raises it to just
+    // above the evicted transaction's rate, after which it decays exponentially back toward zero.
+    class RollingMinFeeRate
+    {
+    public:
+        RollingMinFeeRate(void)
+        {
+            mFeeRate = 0;
+            mTime = 0;
+        }
+
+        float get(uint32_t timeStamp) const
+        {
+            float ret = mFeeRate;
+            if (ret > 0 && timeStamp > mTime)
+            {
+                ret *= exp2f(-float(timeStamp - mTime) / float(MIN_FEE_RATE_HALF_LIFE));
+                if (ret < MIN_FEE_RATE_INCREMENT * 0.5f)
+                {
+                    ret = 0;
+                }
+            }
+            return ret;
+        }
+
+        void raise(float evictedFeeRate, uint32_t timeStamp)
+        {
+            float current = get(timeStamp);
+            float feeRate = evictedFeeRate + MIN_FEE_RATE_INCREMENT;
+            mFeeRate = feeRate > current ? feeRate : current;
+            mTime = timeStamp;
+        }
+
+    private:
+        float       mFeeRate;       // satoshis per byte as of mTime
+        uint32_t    mTime;
+    };
+
+    // Count and bytes of pending transactions per fee-rate bucket
+    class FeeRateHistogram
+    {
+    public:
+        FeeRateHistogram(void)
+        {
+            clear();
+        }
+        void clear(void)
+        {
+            for (uint32_t i = 0; i < FEE_RATE_BUCKETS; i++)
+            {
+                mCount[i] = 0;
+                mBytes[i] = 0;
+            }
+        }
+        uint32_t    mCount[FEE_RATE_BUCKETS];
+        uint64_t    mBytes[FEE_RATE_BUCKETS];
+    };
+
+} // end of blockchainsim namespace
+
+#endif
@@ -0,0 +1,129 @@
+#include "GaussBenchmark.h"
+#include "SimulationSettings.h"
+#include "Population.h"
+#include "NsString.h"
+#include "gauss.h"
+#include "logging.h"
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+namespace blockchainsim
+{
+
+    typedef std::vector< float > FloatVector;
+
+    class SampleStats
+    {
+    public:
+        SampleStats(void) : mMean(0), mStandardDeviation(0), mNanoseconds(0)
+        {
+        }
+        double  mMean;
+        double  mStandardDeviation;
+        double  mNanoseconds;       // cost per sample
+    };
+
+    static void sample(Gauss g, bool ziggurat, FloatVector &out, SampleStats &stats)
+    {
+        if (ziggurat)
+        {
+            g.SetGaussFlag(GF_ZIGGURAT);
+        }
+        else
+        {
+            g.ClearGaussFlag(GF_ZIGGURAT);
+        }
+        Rand r(1);
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < out.size(); i++)
+        {
+            out[i] = g.Get(r);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        stats.mNanoseconds = std::chrono::duration< double, std::nano >(end - start).count() / double(out.size());
+
+        double total = 0;
+        double total2 = 0;
+        for (auto v : out)
+        {
+            total += v;
+            total2 += double(v) * double(v);
+        }
+        double n = double(out.size());
+        stats.mMean = total / n;
+        stats.mStandardDeviation = sqrt(std::max(0.0, total2 / n - stats.mMean * stats.mMean));
+    }
+
+    // Largest distance between the two empirical distribution functions
+    static double ksDistance(FloatVector &a, FloatVector &b)
+    {
+        std::sort(a.begin(), a.end());
+        std::sort(b.begin(), b.end());
+        size_t i = 0;
+        size_t j = 0;
+        double ret = 0;
+        while (i < a.size() && j < b.size())
+        {
+            float v = std::min(a[i], b[j]);
+            while (i < a.size() && a[i] == v) i++;
+            while (j < b.size() && b[j] == v) j++;
+            double d = fabs(double(i) / double(a.size()) - double(j) / double(b.size()));
+            ret = std::max(ret, d);
+        }
+        return ret;
+    }
+
+    static void benchmarkSpec(const char *name, const Gauss &g, uint32_t sampleCount)
+    {
+        if (!g.HasGaussFlag(GF_STDEV) || g.HasGaussFlag(GF_LINEAR))
+        {
+            return; // nothing to compare
+        }
+        FloatVector polar(sampleCount);
+        FloatVector ziggurat(sampleCount);
+        SampleStats ps;
+        SampleStats zs;
+        sample(g, false, polar, ps);
+        sample(g, true, ziggurat, zs);
+        double d = ksDistance(polar, ziggurat);
+        // 1% critical value of the two-sample test with equal sample sizes
+        double critical = 1.628 * sqrt(2.0 / double(sampleCount));
+        String spec;
+        g.GetString(spec);
+        logMessage("%-34s %-32s polar: mean %12.4f std %10.4f %6.2fns | ziggurat: mean %12.4f std %10.4f %6.2fns | KS %.5f (%s)\n",
+            name, spec.c_str(),
+            ps.mMean, ps.mStandardDeviation, ps.mNanoseconds,
+            zs.mMean, zs.mStandardDeviation, zs.mNanoseconds,
+            d, d < critical ? "equivalent" : "DIFFERENT");
+    }
+
+    void benchmarkGauss(const SimulationSettings &s, uint32_t sampleCount)
+    {
+        logMessage("Comparing polar and Ziggurat samplers with %d samples per spec\n", sampleCount);
+        benchmarkSpec("BLOCK_TIME", s.getBlockTime(), sampleCount);
+        benchmarkSpec("MAX_BLOCK_SIZE", s.getMaxBlockSize(), sampleCount);
+        benchmarkSpec("TRANSACTION_SIZE", s.getTransactionSize(), sampleCount);
+        benchmarkSpec("BLOCK_COUNT", s.getBlockCount(), sampleCount);
+        // the specs sampled for every generated transaction; a replayed trace samples none of them
+        for (uint32_t i = 0; i < s.getPopulationCount(); i++)
+        {
+            const PopulationDesc &desc = s.getPopulation(i);
+            if (!desc.mTraceFile.empty())
+            {
+                continue;
+            }
+            char name[512];
+            stringFormat(name, "%s TRANSACTIONS_PER_SECOND", desc.mName.c_str());
+            benchmarkSpec(name, desc.mTransactionsPerSecond, sampleCount);
+            stringFormat(name, "%s FEE", desc.mName.c_str());
+            benchmarkSpec(name, desc.mFee, sampleCount);
+            stringFormat(name, "%s VALUE", desc.mName.c_str());
+            benchmarkSpec(name, desc.mValue, sampleCount);
+            stringFormat(name, "%s SIZE", desc.mName.c_str());
+            benchmarkSpec(name, desc.mSize, sampleCount);
+        }
+    }
+
+} // end of blockchainsim namespace
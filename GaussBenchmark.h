@@ -0,0 +1,18 @@
+#ifndef GAUSS_BENCHMARK_H
+#define GAUSS_BENCHMARK_H
+
+#include <stdint.h>
+
+// Compares the polar and Ziggurat normal samplers on every Gaussian spec in the simulation
+// settings; reports speed, moments and the two-sample Kolmogorov-Smirnov distance.
+
+namespace blockchainsim
+{
+
+    class SimulationSettings;
+
+    void benchmarkGauss(const SimulationSettings &s, uint32_t sampleCount);
+
+} // end of blockchainsim namespace
+
+#endif
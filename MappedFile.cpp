@@ -0,0 +1,172 @@
+#include "MappedFile.h"
+#include "NsUserAllocated.h"
+#include "NvPreprocessor.h"
+
+#if NV_WINDOWS_FAMILY
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace blockchainsim
+{
+
+    #define MAPPED_FILE_PAGE 4096       // hint ranges are rounded out to this; a multiple of every page size in use
+
+    class MappedFileImpl : public MappedFile, public UserAllocated
+    {
+    public:
+        MappedFileImpl(void)
+        {
+            mData = nullptr;
+            mSize = 0;
+#if NV_WINDOWS_FAMILY
+            mFile = INVALID_HANDLE_VALUE;
+            mMapping = nullptr;
+#endif
+        }
+
+        virtual ~MappedFileImpl(void)
+        {
+#if NV_WINDOWS_FAMILY
+            if (mData)
+            {
+                UnmapViewOfFile(mData);
+            }
+            if (mMapping)
+            {
+                CloseHandle(mMapping);
+            }
+            if (mFile != INVALID_HANDLE_VALUE)
+            {
+                CloseHandle(mFile);
+            }
+#else
+            if (mData)
+            {
+                munmap((void *)mData, size_t(mSize));
+            }
+#endif
+        }
+
+        bool open(const char *fname)
+        {
+            bool ret = false;
+#if NV_WINDOWS_FAMILY
+            mFile = CreateFileA(fname, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            LARGE_INTEGER size;
+            if (mFile != INVALID_HANDLE_VALUE && GetFileSizeEx(mFile, &size) && size.QuadPart)
+            {
+                mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (mMapping)
+                {
+                    mData = (const uint8_t *)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+                    mSize = uint64_t(size.QuadPart);
+                    ret = mData != nullptr;
+                }
+            }
+#else
+            int fd = ::open(fname, O_RDONLY);
+            if (fd >= 0)
+            {
+                struct stat st;
+                if (fstat(fd, &st) == 0 && st.st_size)
+                {
+                    void *data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (data != MAP_FAILED)
+                    {
+                        madvise(data, size_t(st.st_size), MADV_SEQUENTIAL);     // aggressive read-ahead, early reclaim
+                        mData = (const uint8_t *)data;
+                        mSize = uint64_t(st.st_size);
+                        ret = true;
+                    }
+                }
+                ::close(fd);        // the mapping keeps the file open
+            }
+#endif
+            return ret;
+        }
+
+        virtual const uint8_t *getData(void) const final
+        {
+            return mData;
+        }
+
+        virtual uint64_t getSize(void) const final
+        {
+            return mSize;
+        }
+
+        virtual void willNeed(uint64_t offset, uint64_t size) final
+        {
+            if (clip(offset, size))
+            {
+#if NV_WINDOWS_FAMILY
+#if _WIN32_WINNT >= 0x0602
+                WIN32_MEMORY_RANGE_ENTRY range;
+                range.VirtualAddress = (PVOID)(mData + offset);
+                range.NumberOfBytes = SIZE_T(size);
+                PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+#else
+                madvise((void *)(mData + offset), size_t(size), MADV_WILLNEED);
+#endif
+            }
+        }
+
+        virtual void dontNeed(uint64_t offset, uint64_t size) final
+        {
+            if (clip(offset, size))
+            {
+#if NV_WINDOWS_FAMILY
+                VirtualUnlock((LPVOID)(mData + offset), SIZE_T(size));     // unlocking pages that are not locked trims them from the working set
+#else
+                madvise((void *)(mData + offset), size_t(size), MADV_DONTNEED);
+#endif
+            }
+        }
+
+        virtual void release(void) final
+        {
+            delete this;
+        }
+
+    private:
+        // Widen the range out to whole pages and keep it inside the file; false if nothing is left
+        bool clip(uint64_t &offset, uint64_t &size) const
+        {
+            if (offset >= mSize)
+            {
+                return false;
+            }
+            uint64_t end = offset + size;
+            end = end < mSize ? end : mSize;
+            offset &= ~uint64_t(MAPPED_FILE_PAGE - 1);
+            size = end - offset;
+            return size != 0;
+        }
+
+        const uint8_t   *mData;
+        uint64_t        mSize;
+#if NV_WINDOWS_FAMILY
+        HANDLE          mFile;
+        HANDLE          mMapping;
+#endif
+    };
+
+    MappedFile *MappedFile::create(const char *fname)
+    {
+        MappedFileImpl *m = NV_NEW(MappedFileImpl);
+        if (!m->open(fname))
+        {
+            m->release();
+            m = nullptr;
+        }
+        return static_cast<MappedFile *>(m);
+    }
+
+} // end of blockchainsim namespace
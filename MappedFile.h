@@ -0,0 +1,39 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+// A read-only view of a whole file mapped into the address space.  Pages are read in by the
+// operating system as they are touched, so a file far larger than memory can be streamed through
+// once; the read-ahead hints let a sequential reader keep the disk ahead of it and hand back what
+// it has finished with.
+
+#include <stdint.h>
+
+namespace blockchainsim
+{
+
+    class MappedFile
+    {
+    public:
+        // returns nullptr if the file cannot be opened or is empty
+        static MappedFile *create(const char *fname);
+
+        virtual const uint8_t *getData(void) const = 0;
+
+        virtual uint64_t getSize(void) const = 0;
+
+        // start reading this range in the background; it is about to be used
+        virtual void willNeed(uint64_t offset, uint64_t size) = 0;
+
+        // this range has been read for the last time and need not stay resident
+        virtual void dontNeed(uint64_t offset, uint64_t size) = 0;
+
+        virtual void release(void) = 0;
+    protected:
+        virtual ~MappedFile(void)
+        {
+        }
+    };
+
+} // end of blockchainsim namespace
+
+#endif
@@ -2,6 +2,9 @@
 #include "Transaction.h"
 #include "NsUserAllocated.h"
 #include "NvAssert.h"
+#include "FeeRate.h"
+#include "TimingWheel.h"
+#include "TransactionStore.h"
 #include <set>
 
 #pragma warning(disable:4100)
@@ -9,18 +12,42 @@
 namespace blockchainsim
 {
 
-    typedef std::set< Transaction > TransactionSet;
+    // The set holds only each transaction's ordering key; the transaction itself lives in a TransactionStore
+    class SetEntry
+    {
+    public:
+        // Same order as Transaction::operator< : highest fee first, newest first on ties
+        bool operator<(const SetEntry &a) const
+        {
+            if (a.mFee != mFee)
+            {
+                return a.mFee < mFee;
+            }
+            return a.mID < mID;
+        }
+
+        uint32_t    mFee;
+        uint32_t    mID;
+        uint32_t    mHandle;        // store handle of the transaction; not part of the key
+    };
+
+    typedef std::set< SetEntry > TransactionSet;
 
     class MemPoolImpl : public MemPool, public UserAllocated
     {
     public:
-        MemPoolImpl(void)
+        MemPoolImpl(uint32_t expirySeconds)
         {
             mCount = 0;
             mId = 0;
             mMemPoolSize = 0;
             mTotalValue = 0;
             mTotalFees = 0;
+            mExpirySeconds = expirySeconds;
+            mExpiredCount = 0;
+            mExpiredSize = 0;
+            mExpiredFees = 0;
+            mReplacedCount = 0;
         }
 
         ~MemPoolImpl(void)
@@ -29,24 +56,81 @@ namespace blockchainsim
 
         }
 
-        // opportunity to drop transactions from the mempool if they are too old
+        // drop every transaction that has been waiting longer than the expiry time
         virtual void pump(uint32_t timeStamp)
         {
-
+            // Mined transactions are not taken off the wheel; they are simply not found when they come due
+            auto expire = [this](const uint32_t &id)
+            {
+                uint32_t handle = mStore.find(id);
+                if (handle != STORE_INVALID_SLOT)
+                {
+                    mExpiredCount++;
+                    mExpiredSize += mStore.getSize(handle);
+                    mExpiredFees += mStore.getFee(handle);
+                    removeTransaction(findEntry(handle));
+                }
+            };
+            mExpiry.advance(timeStamp, expire);
         }
 
 
         // add a transaction to the mempool
-        virtual void addTransaction(const Transaction &_t)
+        virtual void addTransaction(const Transaction &_t, uint32_t parentID)
         {
+            if (_t.getFlags() & TF_REPLACEMENT)
+            {
+                Transaction t = _t;
+                t.clearFlags();
+                MemPoolImpl::replaceTransaction(t);
+                return;
+            }
             Transaction t = _t;
-            t.mID = ++mId;
+            t.mID = t.mID ? t.mID : ++mId;
             mMemPoolSize += t.mTransactionSize;
             mTotalFees += t.mFee;
             mTotalValue += t.mValue;
             mCount++;
-            mTransactions.insert(t);
+            SetEntry e;
+            e.mFee = t.mFee;
+            e.mID = t.mID;
+            e.mHandle = mStore.add(t);
+            mTransactions.insert(e);
             NV_ASSERT(mCount == mTransactions.size());
+            if (mExpirySeconds)
+            {
+                mExpiry.insert(t.mTimestamp + mExpirySeconds, t.mID);
+            }
+        }
+
+        // a set key cannot change in place; the replacement's entry is put back with the new fee
+        virtual bool replaceTransaction(const Transaction &t)
+        {
+            uint32_t handle = mStore.find(t.mID);
+            if (handle == STORE_INVALID_SLOT || t.mFee <= mStore.getFee(handle))
+            {
+                return false;
+            }
+            TransactionSet::iterator i = findEntry(handle);
+            SetEntry e = *i;
+            mTransactions.erase(i);
+            mTotalFees += int64_t(t.mFee) - mStore.getFee(handle);
+            mTotalValue += t.mValue - mStore.getValue(handle);
+            mMemPoolSize += t.mTransactionSize - mStore.getSize(handle);
+            mStore.replace(handle, t);
+            e.mFee = t.mFee;
+            mTransactions.insert(e);
+            mReplacedCount++;
+            return true;
+        }
+
+        // add a contiguous batch of transactions to the mempool in one call
+        virtual void addTransactions(const Transaction *t, uint32_t count, const uint32_t *parentIDs)
+        {
+            for (uint32_t i = 0; i < count; i++)
+            {
+                MemPoolImpl::addTransaction(t[i], parentIDs ? parentIDs[i] : 0);
+            }
         }
 
         // peek the next transaction with the highest fee; but don't remove it yet.
@@ -56,8 +140,7 @@ namespace blockchainsim
 
             if (!mTransactions.empty())
             {
-                TransactionSet::iterator i = mTransactions.begin();
-                t = (*i);
+                mStore.get(mTransactions.begin()->mHandle, t);
                 ret = true;
             }
             return ret;
@@ -72,23 +155,62 @@ namespace blockchainsim
             if (!mTransactions.empty())
             {
                 TransactionSet::iterator i = mTransactions.begin();
-                t = (*i);
-
-                mCount--;
-                mTransactions.erase(i);
+                mStore.get(i->mHandle, t);
+                removeTransaction(i);
                 NV_ASSERT(mCount == mTransactions.size());
-
-                mTotalFees -= t.mFee;
-                mTotalValue -= t.mValue;
-                mMemPoolSize -= t.mTransactionSize;
-                NV_ASSERT(mTotalValue >= 0.0f);
-                NV_ASSERT(mTotalFees >= 0.0f);
                 ret = true;
             }
 
             return ret;
         }
 
+        virtual void buildBlock(uint32_t maxBytes, BlockTemplate &out)
+        {
+            out.clear();
+            TransactionSet::iterator i = mTransactions.begin();
+            for (; i != mTransactions.end(); ++i)
+            {
+                uint32_t handle = i->mHandle;
+                uint32_t size = mStore.getSize(handle);
+                if ((out.mBlockSize + size) > maxBytes)
+                {
+                    break;
+                }
+                float feeRate = getFeeRate(i->mFee, size);
+                if (out.mTransactionCount == 0 || feeRate < out.mMinFeeRate)
+                {
+                    out.mMinFeeRate = feeRate;
+                }
+                out.mTransactionCount++;
+                out.mBlockSize += size;
+                out.mBlockFees += i->mFee;
+                out.mBlockValue += mStore.getValue(handle);
+                mStore.remove(handle);
+            }
+            mTransactions.erase(mTransactions.begin(), i);
+
+            mCount -= out.mTransactionCount;
+            NV_ASSERT(mCount == mTransactions.size());
+            mTotalFees -= out.mBlockFees;
+            mTotalValue -= out.mBlockValue;
+            mMemPoolSize -= out.mBlockSize;
+        }
+
+        virtual void getFeeRateHistogram(FeeRateHistogram &h) const
+        {
+            mStore.getFeeRateHistogram(h);
+        }
+
+        virtual void getSnapshot(uint32_t timeStamp, float cutoffFeeRate, MemPoolSnapshot &s) const
+        {
+            mStore.getSnapshot(timeStamp, cutoffFeeRate, s);
+        }
+
+        virtual void addToSnapshot(SnapshotBuilder &b) const
+        {
+            mStore.addToSnapshot(b);
+        }
+
         // report the size of the current mempool in bytes
         virtual uint32_t	getMemPoolSize(void) const
         {
@@ -101,34 +223,130 @@ namespace blockchainsim
             return uint32_t(mTransactions.size());
         }
 
-        virtual double getMemPoolTotalValue(void) const
+        virtual int64_t getMemPoolTotalValue(void) const
         {
             return mTotalValue;
         }
 
-        virtual double getMemPoolTotalFees(void) const
+        virtual int64_t getMemPoolTotalFees(void) const
         {
             return mTotalFees;
         }
 
+        virtual uint32_t getExpiredCount(void) const
+        {
+            return mExpiredCount;
+        }
+
+        virtual uint64_t getExpiredSize(void) const
+        {
+            return mExpiredSize;
+        }
+
+        virtual int64_t getExpiredFees(void) const
+        {
+            return mExpiredFees;
+        }
+
+        // the set is ordered by absolute fee, not fee rate, so it has no right entry to evict and is never capped
+        virtual uint32_t getEvictedCount(void) const
+        {
+            return 0;
+        }
+
+        virtual uint64_t getEvictedSize(void) const
+        {
+            return 0;
+        }
+
+        virtual int64_t getEvictedFees(void) const
+        {
+            return 0;
+        }
+
+        virtual uint32_t getReplacedCount(void) const
+        {
+            return mReplacedCount;
+        }
+
+        virtual float getMinFeeRate(uint32_t timeStamp) const
+        {
+            return 0;
+        }
+
         virtual void release(void)
         {
             delete this;
         }
     protected:
+        TransactionSet::iterator findEntry(uint32_t handle)
+        {
+            SetEntry key;
+            key.mFee = mStore.getFee(handle);
+            key.mID = mStore.getID(handle);
+            return mTransactions.find(key);
+        }
+
+        void removeTransaction(TransactionSet::iterator i)
+        {
+            uint32_t handle = i->mHandle;
+            mTotalFees -= mStore.getFee(handle);
+            mTotalValue -= mStore.getValue(handle);
+            mMemPoolSize -= mStore.getSize(handle);
+            NV_ASSERT(mTotalValue >= 0);
+            NV_ASSERT(mTotalFees >= 0);
+            mCount--;
+            mStore.remove(handle);
+            mTransactions.erase(i);
+        }
+
         size_t          mCount;
         uint32_t        mId;
         uint32_t        mMemPoolSize;
-        double           mTotalValue;
-        double           mTotalFees;
+        int64_t          mTotalValue;
+        int64_t          mTotalFees;
         TransactionSet  mTransactions;
+        TransactionStore< StoreNoLink > mStore;
+        uint32_t        mExpirySeconds;
+        uint32_t        mExpiredCount;
+        uint64_t        mExpiredSize;
+        int64_t         mExpiredFees;
+        TimingWheel< uint32_t > mExpiry;     // transaction IDs
+        uint32_t        mReplacedCount;
     };
 
 
-    MemPool *MemPool::create(void)
+    MemPool *createMemPoolHeap(uint32_t expirySeconds);
+    MemPool *createMemPoolFeeRate(uint32_t expirySeconds, uint32_t maxSize);
+    MemPool *createMemPoolMinMax(uint32_t expirySeconds, uint32_t maxSize);
+    MemPool *createMemPoolSharded(uint32_t expirySeconds, uint32_t maxSize, uint32_t shardCount);
+    MemPool *createMemPoolPackage(uint32_t expirySeconds, uint32_t maxSize);
+
+    MemPool *MemPool::create(MemPoolType type, uint32_t expirySeconds, uint32_t maxSize, uint32_t shardCount)
     {
-        MemPoolImpl *m = NV_NEW(MemPoolImpl);
-        return static_cast<MemPool *>(m);
+        MemPool *ret = nullptr;
+        switch (type)
+        {
+            case MPT_ORDERED_SET:
+                ret = static_cast<MemPool *>(NV_NEW(MemPoolImpl)(expirySeconds));
+                break;
+            case MPT_INDEXED_HEAP:
+                ret = createMemPoolHeap(expirySeconds);
+                break;
+            case MPT_FEE_RATE_BUCKETS:
+                ret = createMemPoolFeeRate(expirySeconds, maxSize);
+                break;
+            case MPT_MIN_MAX_HEAP:
+                ret = createMemPoolMinMax(expirySeconds, maxSize);
+                break;
+            case MPT_SHARDED:
+                ret = createMemPoolSharded(expirySeconds, maxSize, shardCount);
+                break;
+            case MPT_ANCESTOR_PACKAGES:
+                ret = createMemPoolPackage(expirySeconds, maxSize);
+                break;
+        }
+        return ret;
     }
 
 } // end of blockchainsim namespace
\ No newline at end of file
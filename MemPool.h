@@ -2,22 +2,86 @@
 #define MEM_POOL_H
 
 #include <stdint.h>
+#include "Transaction.h"
 
 namespace blockchainsim
 {
 
-    class Transaction;
+    class FeeRateHistogram;
+    class SnapshotBuilder;
 
-    class MemPool
+    // The data structure used to order pending transactions
+    enum MemPoolType
+    {
+        MPT_ORDERED_SET,        // std::set ordered by fee; one tree node allocation per transaction
+        MPT_INDEXED_HEAP,       // 4-ary heap over contiguous storage with records in a TransactionStore
+        MPT_FEE_RATE_BUCKETS,   // logarithmic fee-per-byte buckets, FIFO within a bucket; O(1) insert and selection
+        MPT_MIN_MAX_HEAP,       // min-max heap by exact fee per byte; O(log n) access to both the best and the worst
+        MPT_SHARDED,            // min-max heaps in separately locked shards, merged when a block is assembled; safe to share between threads
+        MPT_ANCESTOR_PACKAGES,  // min-max heap by ancestor package fee rate, so a child can pay for its parents (CPFP)
+    };
+
+    // The result of assembling one block from the mempool
+    class BlockTemplate
+    {
+    public:
+        BlockTemplate(void)
+        {
+            clear();
+        }
+        void clear(void)
+        {
+            mTransactionCount = 0;
+            mBlockSize = 0;
+            mBlockFees = 0;
+            mBlockValue = 0;
+            mMinFeeRate = 0;
+        }
+        uint32_t    mTransactionCount;  // how many transactions were selected
+        uint32_t    mBlockSize;         // total size in bytes of the selected transactions
+        int64_t     mBlockFees;         // total fees of the selected transactions in satoshis
+        int64_t     mBlockValue;        // total value of the selected transactions in satoshis
+        float       mMinFeeRate;        // lowest fee rate (satoshis per byte) among the selected transactions
+    };
+
+    // Statistics over every pending transaction at one moment
+    class MemPoolSnapshot
+    {
+    public:
+        uint32_t    mCount;             // pending transactions
+        uint64_t    mBytes;             // pending bytes
+        uint64_t    mBytesAboveCutoff;  // pending bytes paying at least the cutoff fee rate asked for
+        float       mFeeRateP10;        // fee rate percentiles by transaction count, in satoshis per byte
+        float       mFeeRateP50;
+        float       mFeeRateP90;
+        uint32_t    mMedianAge;         // seconds the median transaction has been waiting
+        uint32_t    mOldestAge;         // seconds the oldest transaction has been waiting
+    };
+
+    class MemPool : public TransactionSink
     {
     public:
-        static MemPool *create(void);
+        // 'expirySeconds' is how long a transaction may wait in the mempool before pump drops it; zero means never.
+        // 'maxSize' caps the mempool in bytes; once full, the transactions that would be mined last are evicted
+        // and the minimum fee rate rises.  Zero means unbounded; MPT_ORDERED_SET and MPT_INDEXED_HEAP cannot evict by fee rate, so the settings reject a cap for them.
+        // 'shardCount' is only used by MPT_SHARDED; zero means one shard per hardware thread.
+        static MemPool *create(MemPoolType type = MPT_ORDERED_SET, uint32_t expirySeconds = 0, uint32_t maxSize = 0, uint32_t shardCount = 0);
 
-        // opportunity to drop transactions from the mempool if they are too old
+        // drop every transaction that has been waiting longer than the expiry time as of 'timeStamp'
         virtual void pump(uint32_t timeStamp) = 0;
 
-        // add a transaction to the mempool
-        virtual void addTransaction(const Transaction &t) = 0;
+        // Add a transaction to the mempool.  One with a zero ID is numbered by the mempool; populations number
+        // their own, so that a child can name its parent in 'parentID' (zero for none; only MPT_ANCESTOR_PACKAGES
+        // tracks it).  One flagged TF_REPLACEMENT goes to replaceTransaction.
+        virtual void addTransaction(const Transaction &t, uint32_t parentID) = 0;
+
+        // Replace-by-fee: 't' takes the place of the pending transaction with the same ID, which is re-keyed
+        // where it sits and keeps its original timestamp and expiry.  Returns false, dropping 't', unless the
+        // original is still pending and 't' pays a higher fee.
+        virtual bool replaceTransaction(const Transaction &t) = 0;
+
+        // add a contiguous batch of transactions to the mempool in one call; 'parentIDs' may be null
+        virtual void addTransactions(const Transaction *t, uint32_t count, const uint32_t *parentIDs) = 0;
 
         // peek the next transaction with the highest fee; but don't remove it yet.
         virtual bool peekTransaction(Transaction &t) = 0;
@@ -25,15 +89,47 @@ namespace blockchainsim
         // get the next transaction with the highest fee
         virtual bool getTransaction(Transaction &t) = 0;
 
+        // Select and remove the highest fee transactions, in order, until the next one would not fit
+        // in 'maxBytes'.  Equivalent to a peekTransaction/getTransaction loop but done in one pass,
+        // with the mempool totals updated once at the end.
+        virtual void buildBlock(uint32_t maxBytes, BlockTemplate &out) = 0;
+
+        // report the count and bytes of pending transactions per fee-rate bucket (see FeeRate.h)
+        virtual void getFeeRateHistogram(FeeRateHistogram &h) const = 0;
+
+        // Summarize the pending transactions as of 'timeStamp'.  Percentiles are accurate to within a fee-rate
+        // bucket; 'cutoffFeeRate' selects which transactions count toward mBytesAboveCutoff.
+        virtual void getSnapshot(uint32_t timeStamp, float cutoffFeeRate, MemPoolSnapshot &s) const = 0;
+
+        // feed every pending transaction to 'b'; lets a mempool made of several others summarize them together
+        virtual void addToSnapshot(SnapshotBuilder &b) const = 0;
+
         // report the size of the current mempool in bytes
         virtual uint32_t	getMemPoolSize(void) const = 0;
 
         // report the number of pending transactions in the mempool
         virtual uint32_t	getMemPoolCount(void) const = 0;
 
-        virtual double getMemPoolTotalValue(void) const = 0;
-        virtual double getMemPoolTotalFees(void) const = 0;
+        // exact totals of the pending transactions in satoshis
+        virtual int64_t getMemPoolTotalValue(void) const = 0;
+        virtual int64_t getMemPoolTotalFees(void) const = 0;
+
+        // running totals of the transactions pump has dropped because they expired
+        virtual uint32_t getExpiredCount(void) const = 0;
+        virtual uint64_t getExpiredSize(void) const = 0;
+        virtual int64_t getExpiredFees(void) const = 0;
+
+        // running totals of the transactions evicted from a full mempool or turned away by its minimum fee rate;
+        // the package mempool also counts those turned away for exceeding the package limits
+        virtual uint32_t getEvictedCount(void) const = 0;
+        virtual uint64_t getEvictedSize(void) const = 0;
+        virtual int64_t getEvictedFees(void) const = 0;
+
+        // running count of the pending transactions replaced by a higher fee
+        virtual uint32_t getReplacedCount(void) const = 0;
 
+        // the fee rate (satoshis per byte) a new transaction must pay to be accepted; zero unless the mempool has been full
+        virtual float getMinFeeRate(uint32_t timeStamp) const = 0;
 
         virtual void release(void) = 0;
     protected:
@@ -0,0 +1,442 @@
+#include "MemPool.h"
+#include "Transaction.h"
+#include "FeeRate.h"
+#include "TimingWheel.h"
+#include "TransactionStore.h"
+#include "NsUserAllocated.h"
+#include "NvAssert.h"
+
+#pragma warning(disable:4100)
+
+// A mempool that bins transactions into logarithmic fee-per-byte buckets, first-in first-out
+// within each bucket.  A bitmask of non-empty buckets finds the best bucket with one bit scan,
+// so insertion and block selection are O(1) and the fee-rate histogram is maintained for free.
+
+namespace blockchainsim
+{
+
+    #define INVALID_HANDLE 0xFFFFFFFF
+    #define BUCKET_MASK_WORDS (FEE_RATE_BUCKETS/64)
+
+    // ties a stored transaction into its bucket's queue
+    class BucketLink
+    {
+    public:
+        uint32_t    mBucket;        // which fee-rate bucket this transaction is queued in
+        uint32_t    mNext;          // toward the tail (newer) of the bucket's queue
+        uint32_t    mPrev;          // toward the head (older) of the bucket's queue
+    };
+
+    class Bucket
+    {
+    public:
+        Bucket(void) : mHead(INVALID_HANDLE), mTail(INVALID_HANDLE)
+        {
+        }
+        uint32_t    mHead;          // oldest transaction; the next one to be mined from this bucket
+        uint32_t    mTail;          // newest transaction
+    };
+
+    // what the expiry wheel remembers about a record; the ID detects a handle that was mined and reused
+    class BucketExpiry
+    {
+    public:
+        uint32_t    mHandle;
+        uint32_t    mID;
+    };
+
+    class MemPoolFeeRateImpl : public MemPool, public UserAllocated
+    {
+    public:
+        MemPoolFeeRateImpl(uint32_t expirySeconds, uint32_t maxSize)
+        {
+            mId = 0;
+            mExpirySeconds = expirySeconds;
+            mExpiredCount = 0;
+            mExpiredSize = 0;
+            mExpiredFees = 0;
+            mMaxSize = maxSize;
+            mEvictedCount = 0;
+            mEvictedSize = 0;
+            mEvictedFees = 0;
+            mReplacedCount = 0;
+            mCount = 0;
+            mMemPoolSize = 0;
+            mTotalValue = 0;
+            mTotalFees = 0;
+            for (uint32_t i = 0; i < BUCKET_MASK_WORDS; i++)
+            {
+                mNonEmpty[i] = 0;
+            }
+        }
+
+        virtual ~MemPoolFeeRateImpl(void)
+        {
+        }
+
+        // drop every transaction that has been waiting longer than the expiry time
+        virtual void pump(uint32_t timeStamp) final
+        {
+            // A handle that no longer holds the same ID was mined (and maybe reused) since
+            auto expire = [this](const BucketExpiry &e)
+            {
+                if (mStore.contains(e.mHandle, e.mID))
+                {
+                    Transaction t;
+                    mStore.get(e.mHandle, t);
+                    mExpiredCount++;
+                    mExpiredSize += t.mTransactionSize;
+                    mExpiredFees += t.mFee;
+                    mTotalFees -= t.mFee;
+                    mTotalValue -= t.mValue;
+                    mMemPoolSize -= t.mTransactionSize;
+                    unlink(e.mHandle);
+                }
+            };
+            mExpiry.advance(timeStamp, expire);
+        }
+
+        // add a transaction to the mempool
+        virtual void addTransaction(const Transaction &_t, uint32_t parentID) final
+        {
+            if (_t.getFlags() & TF_REPLACEMENT)
+            {
+                Transaction t = _t;
+                t.clearFlags();
+                replaceTransaction(t);
+                return;
+            }
+            float feeRate = getFeeRate(_t.mFee, _t.mTransactionSize);
+            if (mMaxSize && feeRate < mMinFeeRate.get(_t.mTimestamp))
+            {
+                mEvictedCount++;
+                mEvictedSize += _t.mTransactionSize;
+                mEvictedFees += _t.mFee;
+                return;
+            }
+            Transaction t = _t;
+            t.mID = t.mID ? t.mID : ++mId;
+            uint32_t handle = mStore.add(t);
+            mMemPoolSize += t.mTransactionSize;
+            mTotalFees += t.mFee;
+            mTotalValue += t.mValue;
+            mCount++;
+            enqueue(handle, getFeeRateBucket(feeRate));
+            if (mExpirySeconds)
+            {
+                BucketExpiry x;
+                x.mHandle = handle;
+                x.mID = t.mID;
+                mExpiry.insert(t.mTimestamp + mExpirySeconds, x);
+            }
+            while (mMaxSize && mMemPoolSize > mMaxSize)
+            {
+                evictTransaction(t.mTimestamp);
+            }
+        }
+
+        // the replacement joins the back of the queue of its new fee-rate bucket
+        virtual bool replaceTransaction(const Transaction &t) final
+        {
+            uint32_t handle = mStore.find(t.mID);
+            if (handle == STORE_INVALID_SLOT || t.mFee <= mStore.getFee(handle))
+            {
+                return false;
+            }
+            dequeue(handle);
+            mTotalFees += int64_t(t.mFee) - mStore.getFee(handle);
+            mTotalValue += t.mValue - mStore.getValue(handle);
+            mMemPoolSize += t.mTransactionSize - mStore.getSize(handle);
+            mStore.replace(handle, t);
+            enqueue(handle, getFeeRateBucket(getFeeRate(t.mFee, t.mTransactionSize)));
+            mReplacedCount++;
+            while (mMaxSize && mMemPoolSize > mMaxSize)
+            {
+                evictTransaction(t.mTimestamp);
+            }
+            return true;
+        }
+
+        // add a contiguous batch of transactions to the mempool in one call
+        virtual void addTransactions(const Transaction *t, uint32_t count, const uint32_t *parentIDs) final
+        {
+            for (uint32_t i = 0; i < count; i++)
+            {
+                addTransaction(t[i], parentIDs ? parentIDs[i] : 0);
+            }
+        }
+
+        // peek the oldest transaction in the highest fee-rate bucket; but don't remove it yet.
+        virtual bool peekTransaction(Transaction &t) final
+        {
+            bool ret = false;
+            uint32_t handle = getBest();
+            if (handle != INVALID_HANDLE)
+            {
+                mStore.get(handle, t);
+                ret = true;
+            }
+            return ret;
+        }
+
+        // get the oldest transaction in the highest fee-rate bucket
+        virtual bool getTransaction(Transaction &t) final
+        {
+            bool ret = false;
+            uint32_t handle = getBest();
+            if (handle != INVALID_HANDLE)
+            {
+                mStore.get(handle, t);
+                mTotalFees -= t.mFee;
+                mTotalValue -= t.mValue;
+                mMemPoolSize -= t.mTransactionSize;
+                unlink(handle);
+                ret = true;
+            }
+            return ret;
+        }
+
+        virtual void buildBlock(uint32_t maxBytes, BlockTemplate &out) final
+        {
+            out.clear();
+            for (;;)
+            {
+                uint32_t handle = getBest();
+                if (handle == INVALID_HANDLE)
+                {
+                    break;
+                }
+                uint32_t size = mStore.getSize(handle);
+                if ((out.mBlockSize + size) > maxBytes)
+                {
+                    break;
+                }
+                uint32_t fee = mStore.getFee(handle);
+                float feeRate = getFeeRate(fee, size);
+                if (out.mTransactionCount == 0 || feeRate < out.mMinFeeRate)
+                {
+                    out.mMinFeeRate = feeRate;
+                }
+                out.mTransactionCount++;
+                out.mBlockSize += size;
+                out.mBlockFees += fee;
+                out.mBlockValue += mStore.getValue(handle);
+                unlink(handle);
+            }
+            mTotalFees -= out.mBlockFees;
+            mTotalValue -= out.mBlockValue;
+            mMemPoolSize -= out.mBlockSize;
+        }
+
+        virtual void getFeeRateHistogram(FeeRateHistogram &h) const final
+        {
+            h = mHistogram;
+        }
+
+        virtual void getSnapshot(uint32_t timeStamp, float cutoffFeeRate, MemPoolSnapshot &s) const final
+        {
+            mStore.getSnapshot(timeStamp, cutoffFeeRate, s);
+        }
+
+        virtual void addToSnapshot(SnapshotBuilder &b) const final
+        {
+            mStore.addToSnapshot(b);
+        }
+
+        // report the size of the current mempool in bytes
+        virtual uint32_t getMemPoolSize(void) const final
+        {
+            return mMemPoolSize;
+        }
+
+        // report the number of pending transactions in the mempool
+        virtual uint32_t getMemPoolCount(void) const final
+        {
+            return mCount;
+        }
+
+        virtual int64_t getMemPoolTotalValue(void) const final
+        {
+            return mTotalValue;
+        }
+
+        virtual int64_t getMemPoolTotalFees(void) const final
+        {
+            return mTotalFees;
+        }
+
+        virtual uint32_t getExpiredCount(void) const final
+        {
+            return mExpiredCount;
+        }
+
+        virtual uint64_t getExpiredSize(void) const final
+        {
+            return mExpiredSize;
+        }
+
+        virtual int64_t getExpiredFees(void) const final
+        {
+            return mExpiredFees;
+        }
+
+        virtual uint32_t getEvictedCount(void) const final
+        {
+            return mEvictedCount;
+        }
+
+        virtual uint64_t getEvictedSize(void) const final
+        {
+            return mEvictedSize;
+        }
+
+        virtual int64_t getEvictedFees(void) const final
+        {
+            return mEvictedFees;
+        }
+
+        virtual uint32_t getReplacedCount(void) const final
+        {
+            return mReplacedCount;
+        }
+
+        virtual float getMinFeeRate(uint32_t timeStamp) const final
+        {
+            return mMinFeeRate.get(timeStamp);
+        }
+
+        virtual void release(void) final
+        {
+            delete this;
+        }
+
+    protected:
+        // head of the highest non-empty bucket
+        uint32_t getBest(void) const
+        {
+            for (uint32_t i = BUCKET_MASK_WORDS; i != 0; i--)
+            {
+                uint64_t mask = mNonEmpty[i - 1];
+                if (mask)
+                {
+                    uint32_t b = (i - 1) * 64 + getHighestBit(mask);
+                    return mBuckets[b].mHead;
+                }
+            }
+            return INVALID_HANDLE;
+        }
+
+        // drop the newest transaction in the lowest non-empty bucket; the one that would be mined last
+        void evictTransaction(uint32_t timeStamp)
+        {
+            for (uint32_t i = 0; i < BUCKET_MASK_WORDS; i++)
+            {
+                uint64_t mask = mNonEmpty[i];
+                if (mask)
+                {
+                    uint32_t b = i * 64 + getLowestBit(mask);
+                    uint32_t handle = mBuckets[b].mTail;
+                    Transaction t;
+                    mStore.get(handle, t);
+                    mEvictedCount++;
+                    mEvictedSize += t.mTransactionSize;
+                    mEvictedFees += t.mFee;
+                    mMinFeeRate.raise(getFeeRate(t.mFee, t.mTransactionSize), timeStamp);
+                    mTotalFees -= t.mFee;
+                    mTotalValue -= t.mValue;
+                    mMemPoolSize -= t.mTransactionSize;
+                    unlink(handle);
+                    break;
+                }
+            }
+        }
+
+        // queue a stored transaction at the tail of bucket 'b'
+        void enqueue(uint32_t handle, uint32_t b)
+        {
+            BucketLink &r = mStore.getLink(handle);
+            r.mBucket = b;
+            r.mNext = INVALID_HANDLE;
+            Bucket &bucket = mBuckets[b];
+            r.mPrev = bucket.mTail;
+            if (bucket.mTail == INVALID_HANDLE)
+            {
+                bucket.mHead = handle;
+                mNonEmpty[b >> 6] |= uint64_t(1) << (b & 63);
+            }
+            else
+            {
+                mStore.getLink(bucket.mTail).mNext = handle;
+            }
+            bucket.mTail = handle;
+            mHistogram.mCount[b]++;
+            mHistogram.mBytes[b] += mStore.getSize(handle);
+        }
+
+        // take a transaction out of its bucket and the store without touching the totals
+        void unlink(uint32_t handle)
+        {
+            dequeue(handle);
+            mCount--;
+            mStore.remove(handle);
+        }
+
+        // take a transaction out of its bucket's queue, leaving it in the store
+        void dequeue(uint32_t handle)
+        {
+            BucketLink &r = mStore.getLink(handle);
+            uint32_t b = r.mBucket;
+            Bucket &bucket = mBuckets[b];
+            if (r.mPrev == INVALID_HANDLE)
+            {
+                bucket.mHead = r.mNext;
+            }
+            else
+            {
+                mStore.getLink(r.mPrev).mNext = r.mNext;
+            }
+            if (r.mNext == INVALID_HANDLE)
+            {
+                bucket.mTail = r.mPrev;
+            }
+            else
+            {
+                mStore.getLink(r.mNext).mPrev = r.mPrev;
+            }
+            if (bucket.mHead == INVALID_HANDLE)
+            {
+                mNonEmpty[b >> 6] &= ~(uint64_t(1) << (b & 63));
+            }
+            mHistogram.mCount[b]--;
+            mHistogram.mBytes[b] -= mStore.getSize(handle);
+        }
+
+        uint32_t                    mId;
+        uint32_t                    mCount;
+        uint32_t                    mMemPoolSize;
+        int64_t                     mTotalValue;
+        int64_t                     mTotalFees;
+        uint64_t                    mNonEmpty[BUCKET_MASK_WORDS];   // one bit per non-empty bucket
+        Bucket                      mBuckets[FEE_RATE_BUCKETS];
+        uint32_t                    mExpirySeconds;
+        uint32_t                    mExpiredCount;
+        uint64_t                    mExpiredSize;
+        int64_t                     mExpiredFees;
+        FeeRateHistogram            mHistogram;
+        TransactionStore< BucketLink > mStore;
+        TimingWheel< BucketExpiry > mExpiry;
+        uint32_t                    mMaxSize;
+        uint32_t                    mEvictedCount;
+        uint64_t                    mEvictedSize;
+        int64_t                     mEvictedFees;
+        RollingMinFeeRate           mMinFeeRate;
+        uint32_t                    mReplacedCount;
+    };
+
+    MemPool *createMemPoolFeeRate(uint32_t expirySeconds, uint32_t maxSize)
+    {
+        MemPoolFeeRateImpl *m = NV_NEW(MemPoolFeeRateImpl)(expirySeconds, maxSize);
+        return static_cast<MemPool *>(m);
+    }
+
+} // end of blockchainsim namespace
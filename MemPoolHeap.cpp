@@ -0,0 +1,392 @@
+#include "MemPool.h"
+#include "Transaction.h"
+#include "TransactionStore.h"
+#include "FeeRate.h"
+#include "TimingWheel.h"
+#include "NsUserAllocated.h"
+#include "NvAssert.h"
+#include <vector>
+
+#pragma warning(disable:4100)
+
+// A mempool stored as a 4-ary max-heap over a contiguous array.  Each heap entry carries its
+// ordering key inline so sifting never touches the transactions, which live in a TransactionStore
+// and are addressed by handle.  Each handle's link is its heap slot, so any transaction can be
+// removed by handle in O(log n).
+
+namespace blockchainsim
+{
+
+    #define HEAP_ARITY 4
+
+    class HeapEntry
+    {
+    public:
+        // Same order as Transaction::operator< : highest fee first, newest first on ties
+        bool isBetter(const HeapEntry &e) const
+        {
+            if (mFee != e.mFee)
+            {
+                return mFee > e.mFee;
+            }
+            return mID > e.mID;
+        }
+
+        uint32_t    mFee;
+        uint32_t    mID;
+        uint32_t    mHandle;        // store handle of the transaction
+    };
+
+    typedef std::vector< HeapEntry > HeapEntryVector;
+
+    // what the expiry wheel remembers about a record; the ID detects a handle that was mined and reused
+    class HeapExpiry
+    {
+    public:
+        uint32_t    mHandle;
+        uint32_t    mID;
+    };
+
+    class MemPoolHeapImpl : public MemPool, public UserAllocated
+    {
+    public:
+        MemPoolHeapImpl(uint32_t expirySeconds)
+        {
+            mId = 0;
+            mExpirySeconds = expirySeconds;
+            mExpiredCount = 0;
+            mExpiredSize = 0;
+            mExpiredFees = 0;
+            mMemPoolSize = 0;
+            mTotalValue = 0;
+            mTotalFees = 0;
+            mReplacedCount = 0;
+        }
+
+        virtual ~MemPoolHeapImpl(void)
+        {
+        }
+
+        // drop every transaction that has been waiting longer than the expiry time
+        virtual void pump(uint32_t timeStamp) final
+        {
+            // A handle that no longer holds the same ID was mined (and maybe reused) since
+            auto expire = [this](const HeapExpiry &e)
+            {
+                if (mStore.contains(e.mHandle, e.mID))
+                {
+                    mExpiredCount++;
+                    mExpiredSize += mStore.getSize(e.mHandle);
+                    mExpiredFees += mStore.getFee(e.mHandle);
+                    removeTransaction(e.mHandle);
+                }
+            };
+            mExpiry.advance(timeStamp, expire);
+        }
+
+        // add a transaction to the mempool
+        virtual void addTransaction(const Transaction &_t, uint32_t parentID) final
+        {
+            if (_t.getFlags() & TF_REPLACEMENT)
+            {
+                Transaction t = _t;
+                t.clearFlags();
+                replaceTransaction(t);
+                return;
+            }
+            Transaction t = _t;
+            t.mID = t.mID ? t.mID : ++mId;
+            uint32_t handle = mStore.add(t);
+            mMemPoolSize += t.mTransactionSize;
+            mTotalFees += t.mFee;
+            mTotalValue += t.mValue;
+
+            HeapEntry e;
+            e.mFee = t.mFee;
+            e.mID = t.mID;
+            e.mHandle = handle;
+            mHeap.push_back(e);
+            siftUp(uint32_t(mHeap.size() - 1));
+            if (mExpirySeconds)
+            {
+                HeapExpiry x;
+                x.mHandle = handle;
+                x.mID = t.mID;
+                mExpiry.insert(t.mTimestamp + mExpirySeconds, x);
+            }
+        }
+
+        // A higher fee only ever moves the entry toward the root, so the re-key is a single sift up
+        virtual bool replaceTransaction(const Transaction &t) final
+        {
+            uint32_t handle = mStore.find(t.mID);
+            if (handle == STORE_INVALID_SLOT || t.mFee <= mStore.getFee(handle))
+            {
+                return false;
+            }
+            mTotalFees += int64_t(t.mFee) - mStore.getFee(handle);
+            mTotalValue += t.mValue - mStore.getValue(handle);
+            mMemPoolSize += t.mTransactionSize - mStore.getSize(handle);
+            mStore.replace(handle, t);
+            uint32_t index = mStore.getLink(handle);
+            mHeap[index].mFee = t.mFee;
+            siftUp(index);
+            mReplacedCount++;
+            return true;
+        }
+
+        // add a contiguous batch of transactions to the mempool in one call
+        virtual void addTransactions(const Transaction *t, uint32_t count, const uint32_t *parentIDs) final
+        {
+            for (uint32_t i = 0; i < count; i++)
+            {
+                addTransaction(t[i], parentIDs ? parentIDs[i] : 0);
+            }
+        }
+
+        // peek the next transaction with the highest fee; but don't remove it yet.
+        virtual bool peekTransaction(Transaction &t) final
+        {
+            bool ret = false;
+            if (!mHeap.empty())
+            {
+                mStore.get(mHeap[0].mHandle, t);
+                ret = true;
+            }
+            return ret;
+        }
+
+        // get the next transaction with the highest fee
+        virtual bool getTransaction(Transaction &t) final
+        {
+            bool ret = false;
+            if (!mHeap.empty())
+            {
+                uint32_t handle = mHeap[0].mHandle;
+                mStore.get(handle, t);
+                removeTransaction(handle);
+                ret = true;
+            }
+            return ret;
+        }
+
+        virtual void buildBlock(uint32_t maxBytes, BlockTemplate &out) final
+        {
+            out.clear();
+            while (!mHeap.empty())
+            {
+                uint32_t handle = mHeap[0].mHandle;
+                uint32_t size = mStore.getSize(handle);
+                if ((out.mBlockSize + size) > maxBytes)
+                {
+                    break;
+                }
+                uint32_t fee = mStore.getFee(handle);
+                float feeRate = getFeeRate(fee, size);
+                if (out.mTransactionCount == 0 || feeRate < out.mMinFeeRate)
+                {
+                    out.mMinFeeRate = feeRate;
+                }
+                out.mTransactionCount++;
+                out.mBlockSize += size;
+                out.mBlockFees += fee;
+                out.mBlockValue += mStore.getValue(handle);
+                unlink(handle);
+            }
+            mTotalFees -= out.mBlockFees;
+            mTotalValue -= out.mBlockValue;
+            mMemPoolSize -= out.mBlockSize;
+        }
+
+        virtual void getFeeRateHistogram(FeeRateHistogram &h) const final
+        {
+            mStore.getFeeRateHistogram(h);
+        }
+
+        virtual void getSnapshot(uint32_t timeStamp, float cutoffFeeRate, MemPoolSnapshot &s) const final
+        {
+            mStore.getSnapshot(timeStamp, cutoffFeeRate, s);
+        }
+
+        virtual void addToSnapshot(SnapshotBuilder &b) const final
+        {
+            mStore.addToSnapshot(b);
+        }
+
+        // report the size of the current mempool in bytes
+        virtual uint32_t getMemPoolSize(void) const final
+        {
+            return mMemPoolSize;
+        }
+
+        // report the number of pending transactions in the mempool
+        virtual uint32_t getMemPoolCount(void) const final
+        {
+            return uint32_t(mHeap.size());
+        }
+
+        virtual int64_t getMemPoolTotalValue(void) const final
+        {
+            return mTotalValue;
+        }
+
+        virtual int64_t getMemPoolTotalFees(void) const final
+        {
+            return mTotalFees;
+        }
+
+        virtual uint32_t getExpiredCount(void) const final
+        {
+            return mExpiredCount;
+        }
+
+        virtual uint64_t getExpiredSize(void) const final
+        {
+            return mExpiredSize;
+        }
+
+        virtual int64_t getExpiredFees(void) const final
+        {
+            return mExpiredFees;
+        }
+
+        // a max-heap cannot find its worst entry, so this policy never evicts
+        virtual uint32_t getEvictedCount(void) const final
+        {
+            return 0;
+        }
+
+        virtual uint64_t getEvictedSize(void) const final
+        {
+            return 0;
+        }
+
+        virtual int64_t getEvictedFees(void) const final
+        {
+            return 0;
+        }
+
+        virtual uint32_t getReplacedCount(void) const final
+        {
+            return mReplacedCount;
+        }
+
+        virtual float getMinFeeRate(uint32_t timeStamp) const final
+        {
+            return 0;
+        }
+
+        virtual void release(void) final
+        {
+            delete this;
+        }
+
+    protected:
+        // remove any transaction, wherever it sits in the heap
+        void removeTransaction(uint32_t handle)
+        {
+            mTotalFees -= mStore.getFee(handle);
+            mTotalValue -= mStore.getValue(handle);
+            mMemPoolSize -= mStore.getSize(handle);
+            NV_ASSERT(mTotalValue >= 0);
+            NV_ASSERT(mTotalFees >= 0);
+            unlink(handle);
+        }
+
+        // take a transaction out of the heap and the store without touching the totals
+        void unlink(uint32_t handle)
+        {
+            uint32_t index = mStore.getLink(handle);
+            uint32_t last = uint32_t(mHeap.size() - 1);
+            mStore.remove(handle);
+            if (index != last)
+            {
+                mHeap[index] = mHeap[last];
+                mHeap.pop_back();
+                mStore.getLink(mHeap[index].mHandle) = index;
+                if (index > 0 && mHeap[index].isBetter(mHeap[(index - 1) / HEAP_ARITY]))
+                {
+                    siftUp(index);
+                }
+                else
+                {
+                    siftDown(index);
+                }
+            }
+            else
+            {
+                mHeap.pop_back();
+            }
+        }
+
+        void siftUp(uint32_t index)
+        {
+            HeapEntry e = mHeap[index];
+            while (index > 0)
+            {
+                uint32_t parent = (index - 1) / HEAP_ARITY;
+                if (!e.isBetter(mHeap[parent]))
+                {
+                    break;
+                }
+                mHeap[index] = mHeap[parent];
+                mStore.getLink(mHeap[index].mHandle) = index;
+                index = parent;
+            }
+            mHeap[index] = e;
+            mStore.getLink(e.mHandle) = index;
+        }
+
+        void siftDown(uint32_t index)
+        {
+            HeapEntry e = mHeap[index];
+            uint32_t count = uint32_t(mHeap.size());
+            for (;;)
+            {
+                uint32_t first = index * HEAP_ARITY + 1;
+                if (first >= count)
+                {
+                    break;
+                }
+                uint32_t best = first;
+                uint32_t end = first + HEAP_ARITY < count ? first + HEAP_ARITY : count;
+                for (uint32_t c = first + 1; c < end; c++)
+                {
+                    if (mHeap[c].isBetter(mHeap[best]))
+                    {
+                        best = c;
+                    }
+                }
+                if (!mHeap[best].isBetter(e))
+                {
+                    break;
+                }
+                mHeap[index] = mHeap[best];
+                mStore.getLink(mHeap[index].mHandle) = index;
+                index = best;
+            }
+            mHeap[index] = e;
+            mStore.getLink(e.mHandle) = index;
+        }
+
+        uint32_t                    mId;
+        uint32_t                    mMemPoolSize;
+        int64_t                     mTotalValue;
+        int64_t                     mTotalFees;
+        uint32_t                    mExpirySeconds;
+        uint32_t                    mExpiredCount;
+        uint64_t                    mExpiredSize;
+        int64_t                     mExpiredFees;
+        HeapEntryVector             mHeap;
+        TransactionStore< uint32_t > mStore;       // each handle's link is its heap slot
+        TimingWheel< HeapExpiry >   mExpiry;
+        uint32_t                    mReplacedCount;
+    };
+
+    MemPool *createMemPoolHeap(uint32_t expirySeconds)
+    {
+        MemPoolHeapImpl *m = NV_NEW(MemPoolHeapImpl)(expirySeconds);
+        return static_cast<MemPool *>(m);
+    }
+
+} // end of blockchainsim namespace
@@ -0,0 +1,357 @@
+#include "MemPool.h"
+#include "Transaction.h"
+#include "TransactionStore.h"
+#include "MinMaxHeap.h"
+#include "FeeRate.h"
+#include "TimingWheel.h"
+#include "NsUserAllocated.h"
+#include "NvAssert.h"
+
+#pragma warning(disable:4100)
+
+// A mempool ordered by exact fee per byte in a min-max heap, so the next transaction to mine and
+// the next one to evict are both at the top of the same structure.  This is the policy to use
+// with a size cap: every insert into a full mempool evicts the lowest fee-rate transactions in
+// O(log n) each.
+
+namespace blockchainsim
+{
+
+    class MinMaxEntry
+    {
+    public:
+        // highest fee rate first, oldest first on ties
+        bool isBetter(const MinMaxEntry &e) const
+        {
+            if (mFeeRate != e.mFeeRate)
+            {
+                return mFeeRate > e.mFeeRate;
+            }
+            return mID < e.mID;
+        }
+
+        float       mFeeRate;       // satoshis per byte
+        uint32_t    mID;
+        uint32_t    mHandle;        // store handle of the transaction
+    };
+
+    // what the expiry wheel remembers about a record; the ID detects a handle that was mined and reused
+    class MinMaxExpiry
+    {
+    public:
+        uint32_t    mHandle;
+        uint32_t    mID;
+    };
+
+    class MemPoolMinMaxImpl : public MemPool, public UserAllocated
+    {
+    public:
+        MemPoolMinMaxImpl(uint32_t expirySeconds, uint32_t maxSize) : mHeap(*this)
+        {
+            mId = 0;
+            mMemPoolSize = 0;
+            mTotalValue = 0;
+            mTotalFees = 0;
+            mExpirySeconds = expirySeconds;
+            mExpiredCount = 0;
+            mExpiredSize = 0;
+            mExpiredFees = 0;
+            mMaxSize = maxSize;
+            mEvictedCount = 0;
+            mEvictedSize = 0;
+            mEvictedFees = 0;
+            mReplacedCount = 0;
+        }
+
+        virtual ~MemPoolMinMaxImpl(void)
+        {
+        }
+
+        // drop every transaction that has been waiting longer than the expiry time
+        virtual void pump(uint32_t timeStamp) final
+        {
+            // A handle that no longer holds the same ID was mined (and maybe reused) since
+            auto expire = [this](const MinMaxExpiry &e)
+            {
+                if (mStore.contains(e.mHandle, e.mID))
+                {
+                    mExpiredCount++;
+                    mExpiredSize += mStore.getSize(e.mHandle);
+                    mExpiredFees += mStore.getFee(e.mHandle);
+                    removeTransaction(e.mHandle);
+                }
+            };
+            mExpiry.advance(timeStamp, expire);
+        }
+
+        // add a transaction to the mempool
+        virtual void addTransaction(const Transaction &_t, uint32_t parentID) final
+        {
+            if (_t.getFlags() & TF_REPLACEMENT)
+            {
+                Transaction t = _t;
+                t.clearFlags();
+                replaceTransaction(t);
+                return;
+            }
+            float feeRate = getFeeRate(_t.mFee, _t.mTransactionSize);
+            if (mMaxSize && feeRate < mMinFeeRate.get(_t.mTimestamp))
+            {
+                mEvictedCount++;
+                mEvictedSize += _t.mTransactionSize;
+                mEvictedFees += _t.mFee;
+                return;
+            }
+            Transaction t = _t;
+            t.mID = t.mID ? t.mID : ++mId;
+            uint32_t handle = mStore.add(t);
+            mMemPoolSize += t.mTransactionSize;
+            mTotalFees += t.mFee;
+            mTotalValue += t.mValue;
+
+            MinMaxEntry e;
+            e.mFeeRate = feeRate;
+            e.mID = t.mID;
+            e.mHandle = handle;
+            mHeap.push(e);
+            if (mExpirySeconds)
+            {
+                MinMaxExpiry x;
+                x.mHandle = handle;
+                x.mID = t.mID;
+                mExpiry.insert(t.mTimestamp + mExpirySeconds, x);
+            }
+            while (mMaxSize && mMemPoolSize > mMaxSize)
+            {
+                evictTransaction(t.mTimestamp);
+            }
+        }
+
+        virtual bool replaceTransaction(const Transaction &t) final
+        {
+            uint32_t handle = mStore.find(t.mID);
+            if (handle == STORE_INVALID_SLOT || t.mFee <= mStore.getFee(handle))
+            {
+                return false;
+            }
+            mTotalFees += int64_t(t.mFee) - mStore.getFee(handle);
+            mTotalValue += t.mValue - mStore.getValue(handle);
+            mMemPoolSize += t.mTransactionSize - mStore.getSize(handle);
+            mStore.replace(handle, t);
+            MinMaxEntry e;
+            e.mFeeRate = getFeeRate(t.mFee, t.mTransactionSize);
+            e.mID = t.mID;
+            e.mHandle = handle;
+            mHeap.update(mStore.getLink(handle), e);
+            mReplacedCount++;
+            while (mMaxSize && mMemPoolSize > mMaxSize)
+            {
+                evictTransaction(t.mTimestamp);
+            }
+            return true;
+        }
+
+        // add a contiguous batch of transactions to the mempool in one call
+        virtual void addTransactions(const Transaction *t, uint32_t count, const uint32_t *parentIDs) final
+        {
+            for (uint32_t i = 0; i < count; i++)
+            {
+                addTransaction(t[i], parentIDs ? parentIDs[i] : 0);
+            }
+        }
+
+        // peek the transaction with the highest fee rate; but don't remove it yet.
+        virtual bool peekTransaction(Transaction &t) final
+        {
+            bool ret = false;
+            if (!mHeap.empty())
+            {
+                mStore.get(mHeap.best().mHandle, t);
+                ret = true;
+            }
+            return ret;
+        }
+
+        // get the transaction with the highest fee rate
+        virtual bool getTransaction(Transaction &t) final
+        {
+            bool ret = false;
+            if (!mHeap.empty())
+            {
+                uint32_t handle = mHeap.best().mHandle;
+                mStore.get(handle, t);
+                removeTransaction(handle);
+                ret = true;
+            }
+            return ret;
+        }
+
+        virtual void buildBlock(uint32_t maxBytes, BlockTemplate &out) final
+        {
+            out.clear();
+            while (!mHeap.empty())
+            {
+                const MinMaxEntry &e = mHeap.best();
+                uint32_t handle = e.mHandle;
+                uint32_t size = mStore.getSize(handle);
+                if ((out.mBlockSize + size) > maxBytes)
+                {
+                    break;
+                }
+                out.mMinFeeRate = e.mFeeRate;       // selected in fee rate order, so the last one is the lowest
+                out.mTransactionCount++;
+                out.mBlockSize += size;
+                out.mBlockFees += mStore.getFee(handle);
+                out.mBlockValue += mStore.getValue(handle);
+                unlink(handle);
+            }
+            mTotalFees -= out.mBlockFees;
+            mTotalValue -= out.mBlockValue;
+            mMemPoolSize -= out.mBlockSize;
+        }
+
+        virtual void getFeeRateHistogram(FeeRateHistogram &h) const final
+        {
+            mStore.getFeeRateHistogram(h);
+        }
+
+        virtual void getSnapshot(uint32_t timeStamp, float cutoffFeeRate, MemPoolSnapshot &s) const final
+        {
+            mStore.getSnapshot(timeStamp, cutoffFeeRate, s);
+        }
+
+        virtual void addToSnapshot(SnapshotBuilder &b) const final
+        {
+            mStore.addToSnapshot(b);
+        }
+
+        // report the size of the current mempool in bytes
+        virtual uint32_t getMemPoolSize(void) const final
+        {
+            return mMemPoolSize;
+        }
+
+        // report the number of pending transactions in the mempool
+        virtual uint32_t getMemPoolCount(void) const final
+        {
+            return mHeap.size();
+        }
+
+        virtual int64_t getMemPoolTotalValue(void) const final
+        {
+            return mTotalValue;
+        }
+
+        virtual int64_t getMemPoolTotalFees(void) const final
+        {
+            return mTotalFees;
+        }
+
+        virtual uint32_t getExpiredCount(void) const final
+        {
+            return mExpiredCount;
+        }
+
+        virtual uint64_t getExpiredSize(void) const final
+        {
+            return mExpiredSize;
+        }
+
+        virtual int64_t getExpiredFees(void) const final
+        {
+            return mExpiredFees;
+        }
+
+        virtual uint32_t getEvictedCount(void) const final
+        {
+            return mEvictedCount;
+        }
+
+        virtual uint64_t getEvictedSize(void) const final
+        {
+            return mEvictedSize;
+        }
+
+        virtual int64_t getEvictedFees(void) const final
+        {
+            return mEvictedFees;
+        }
+
+        virtual uint32_t getReplacedCount(void) const final
+        {
+            return mReplacedCount;
+        }
+
+        virtual float getMinFeeRate(uint32_t timeStamp) const final
+        {
+            return mMinFeeRate.get(timeStamp);
+        }
+
+        virtual void release(void) final
+        {
+            delete this;
+        }
+
+        // called by the heap every time an entry moves
+        void setIndex(const MinMaxEntry &e, uint32_t index)
+        {
+            mStore.getLink(e.mHandle) = index;
+        }
+
+    protected:
+        // drop the lowest fee-rate transaction and raise the minimum fee rate above it
+        void evictTransaction(uint32_t timeStamp)
+        {
+            const MinMaxEntry &e = mHeap.worst();
+            uint32_t handle = e.mHandle;
+            mEvictedCount++;
+            mEvictedSize += mStore.getSize(handle);
+            mEvictedFees += mStore.getFee(handle);
+            mMinFeeRate.raise(e.mFeeRate, timeStamp);
+            removeTransaction(handle);
+        }
+
+        // remove any transaction, wherever it sits in the heap
+        void removeTransaction(uint32_t handle)
+        {
+            mTotalFees -= mStore.getFee(handle);
+            mTotalValue -= mStore.getValue(handle);
+            mMemPoolSize -= mStore.getSize(handle);
+            NV_ASSERT(mTotalValue >= 0);
+            NV_ASSERT(mTotalFees >= 0);
+            unlink(handle);
+        }
+
+        // take a transaction out of the heap and the store without touching the totals
+        void unlink(uint32_t handle)
+        {
+            mHeap.remove(mStore.getLink(handle));
+            mStore.remove(handle);
+        }
+
+        uint32_t                                        mId;
+        uint32_t                                        mMemPoolSize;
+        int64_t                                         mTotalValue;
+        int64_t                                         mTotalFees;
+        uint32_t                                        mExpirySeconds;
+        uint32_t                                        mExpiredCount;
+        uint64_t                                        mExpiredSize;
+        int64_t                                         mExpiredFees;
+        uint32_t                                        mMaxSize;
+        uint32_t                                        mEvictedCount;
+        uint64_t                                        mEvictedSize;
+        int64_t                                         mEvictedFees;
+        RollingMinFeeRate                               mMinFeeRate;
+        MinMaxHeap< MinMaxEntry, MemPoolMinMaxImpl >    mHeap;
+        TransactionStore< uint32_t >                    mStore;     // each handle's link is its heap slot
+        TimingWheel< MinMaxExpiry >                     mExpiry;
+        uint32_t                                        mReplacedCount;
+    };
+
+    MemPool *createMemPoolMinMax(uint32_t expirySeconds, uint32_t maxSize)
+    {
+        MemPoolMinMaxImpl *m = NV_NEW(MemPoolMinMaxImpl)(expirySeconds, maxSize);
+        return static_cast<MemPool *>(m);
+    }
+
+} // end of blockchainsim namespace
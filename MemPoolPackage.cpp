@@ -0,0 +1,558 @@
+#include "MemPool.h"
+#include "Transaction.h"
+#include "TransactionStore.h"
+#include "MinMaxHeap.h"
+#include "FeeRate.h"
+#include "TimingWheel.h"
+#include "NsUserAllocated.h"
+#include "NvAssert.h"
+#include <vector>
+
+#pragma warning(disable:4100)
+
+// A mempool that mines packages: a transaction together with the pending ancestors it spends.
+// Every transaction keeps the totals of its ancestor package (itself and every pending ancestor)
+// and is ordered in a min-max heap by the package fee rate, so a child paying a high fee pulls its
+// parents into a block (child-pays-for-parent).  A transaction has at most one parent, so the
+// package totals of a new child are its parent's plus its own, in O(1).  When a transaction is
+// mined only its own descendants change; each drops it from its package totals and is re-keyed
+// in the heap.  Package limits keep that walk short.  A parent that is not in the mempool is taken
+// to be confirmed.  Expiring or evicting a transaction takes its descendants with it.
+
+namespace blockchainsim
+{
+
+    #define PACKAGE_MAX_ANCESTORS 25        // longest chain of pending transactions, counting the new one
+    #define PACKAGE_MAX_DESCENDANTS 25      // most pending transactions descending from one, counting itself
+    #define PACKAGE_NONE 0xFFFFFFFF
+
+    // what each store handle knows of its place in the family tree
+    class PackageLink
+    {
+    public:
+        PackageLink(void)
+        {
+            mParent = PACKAGE_NONE;
+            mFirstChild = PACKAGE_NONE;
+            mNextSibling = PACKAGE_NONE;
+            mPrevSibling = PACKAGE_NONE;
+            mHeapIndex = 0;
+            mAncestorCount = 0;
+            mDescendantCount = 0;
+            mAncestorSize = 0;
+            mAncestorFees = 0;
+        }
+
+        uint32_t    mParent;            // store handles; PACKAGE_NONE if there is none
+        uint32_t    mFirstChild;
+        uint32_t    mNextSibling;
+        uint32_t    mPrevSibling;
+        uint32_t    mHeapIndex;
+        uint32_t    mAncestorCount;     // the ancestor package, counting this transaction
+        uint32_t    mDescendantCount;   // counting this transaction
+        uint32_t    mAncestorSize;
+        uint64_t    mAncestorFees;
+    };
+
+    class PackageEntry
+    {
+    public:
+        // highest package fee rate first, oldest first on ties
+        bool isBetter(const PackageEntry &e) const
+        {
+            if (mFeeRate != e.mFeeRate)
+            {
+                return mFeeRate > e.mFeeRate;
+            }
+            return mID < e.mID;
+        }
+
+        float       mFeeRate;       // of the ancestor package, satoshis per byte
+        uint32_t    mID;
+        uint32_t    mHandle;
+    };
+
+    // what the expiry wheel remembers about a record; the ID detects a handle that was removed and reused
+    class PackageExpiry
+    {
+    public:
+        uint32_t    mHandle;
+        uint32_t    mID;
+    };
+
+    typedef std::vector< uint32_t > HandleVector;
+
+    class MemPoolPackageImpl : public MemPool, public UserAllocated
+    {
+    public:
+        MemPoolPackageImpl(uint32_t expirySeconds, uint32_t maxSize) : mHeap(*this)
+        {
+            mId = 0;
+            mMemPoolSize = 0;
+            mTotalValue = 0;
+            mTotalFees = 0;
+            mExpirySeconds = expirySeconds;
+            mExpiredCount = 0;
+            mExpiredSize = 0;
+            mExpiredFees = 0;
+            mMaxSize = maxSize;
+            mEvictedCount = 0;
+            mEvictedSize = 0;
+            mEvictedFees = 0;
+            mReplacedCount = 0;
+        }
+
+        virtual ~MemPoolPackageImpl(void)
+        {
+        }
+
+        // drop every transaction that has been waiting longer than the expiry time, and its descendants
+        virtual void pump(uint32_t timeStamp) final
+        {
+            auto expire = [this](const PackageExpiry &e)
+            {
+                if (mStore.contains(e.mHandle, e.mID))
+                {
+                    removeFamily(e.mHandle, mExpiredCount, mExpiredSize, mExpiredFees);
+                }
+            };
+            mExpiry.advance(timeStamp, expire);
+        }
+
+        virtual void addTransaction(const Transaction &_t, uint32_t parentID) final
+        {
+            if (_t.getFlags() & TF_REPLACEMENT)
+            {
+                Transaction t = _t;
+                t.clearFlags();
+                replaceTransaction(t);
+                return;
+            }
+            float feeRate = getFeeRate(_t.mFee, _t.mTransactionSize);
+            uint32_t parent = findParent(parentID);
+            if ((mMaxSize && feeRate < mMinFeeRate.get(_t.mTimestamp)) || !withinLimits(parent))
+            {
+                mEvictedCount++;
+                mEvictedSize += _t.mTransactionSize;
+                mEvictedFees += _t.mFee;
+                return;
+            }
+            Transaction t = _t;
+            t.mID = t.mID ? t.mID : ++mId;
+            uint32_t handle = mStore.add(t);
+            mMemPoolSize += t.mTransactionSize;
+            mTotalFees += t.mFee;
+            mTotalValue += t.mValue;
+
+            PackageLink &l = mStore.getLink(handle);
+            l = PackageLink();
+            l.mAncestorCount = 1;
+            l.mDescendantCount = 1;
+            l.mAncestorSize = t.mTransactionSize;
+            l.mAncestorFees = t.mFee;
+            if (parent != PACKAGE_NONE)
+            {
+                // The whole package of the parent is this transaction's ancestry
+                PackageLink &p = mStore.getLink(parent);
+                l.mParent = parent;
+                l.mAncestorCount += p.mAncestorCount;
+                l.mAncestorSize += p.mAncestorSize;
+                l.mAncestorFees += p.mAncestorFees;
+                l.mNextSibling = p.mFirstChild;
+                if (p.mFirstChild != PACKAGE_NONE)
+                {
+                    mStore.getLink(p.mFirstChild).mPrevSibling = handle;
+                }
+                p.mFirstChild = handle;
+                for (uint32_t a = parent; a != PACKAGE_NONE; a = mStore.getLink(a).mParent)
+                {
+                    mStore.getLink(a).mDescendantCount++;
+                }
+            }
+            mHeap.push(getEntry(handle));
+            if (mExpirySeconds)
+            {
+                PackageExpiry x;
+                x.mHandle = handle;
+                x.mID = t.mID;
+                mExpiry.insert(t.mTimestamp + mExpirySeconds, x);
+            }
+            while (mMaxSize && mMemPoolSize > mMaxSize)
+            {
+                evictPackage(t.mTimestamp);
+            }
+        }
+
+        // The replacement changes its own package and those of its descendants, which all contain it
+        virtual bool replaceTransaction(const Transaction &t) final
+        {
+            uint32_t handle = mStore.find(t.mID);
+            if (handle == STORE_INVALID_SLOT || t.mFee <= mStore.getFee(handle))
+            {
+                return false;
+            }
+            uint32_t fee = t.mFee - mStore.getFee(handle);
+            uint32_t size = t.mTransactionSize - mStore.getSize(handle);     // wraps if it shrank, which the sums undo
+            mTotalFees += fee;
+            mTotalValue += t.mValue - mStore.getValue(handle);
+            mMemPoolSize += size;
+            mStore.replace(handle, t);
+            collectDescendants(handle);
+            mFamily.push_back(handle);
+            for (uint32_t h : mFamily)
+            {
+                PackageLink &l = mStore.getLink(h);
+                l.mAncestorSize += size;
+                l.mAncestorFees += fee;
+                mHeap.update(l.mHeapIndex, getEntry(h));
+            }
+            mReplacedCount++;
+            while (mMaxSize && mMemPoolSize > mMaxSize)
+            {
+                evictPackage(t.mTimestamp);
+            }
+            return true;
+        }
+
+        virtual void addTransactions(const Transaction *t, uint32_t count, const uint32_t *parentIDs) final
+        {
+            for (uint32_t i = 0; i < count; i++)
+            {
+                addTransaction(t[i], parentIDs ? parentIDs[i] : 0);
+            }
+        }
+
+        // peek the next transaction to mine: the oldest pending ancestor of the best package
+        virtual bool peekTransaction(Transaction &t) final
+        {
+            bool ret = false;
+            if (!mHeap.empty())
+            {
+                mStore.get(getRoot(mHeap.best().mHandle), t);
+                ret = true;
+            }
+            return ret;
+        }
+
+        virtual bool getTransaction(Transaction &t) final
+        {
+            bool ret = false;
+            if (!mHeap.empty())
+            {
+                uint32_t root = getRoot(mHeap.best().mHandle);
+                mStore.get(root, t);
+                mTotalFees -= t.mFee;
+                mTotalValue -= t.mValue;
+                mMemPoolSize -= t.mTransactionSize;
+                mineRoot(root);
+                ret = true;
+            }
+            return ret;
+        }
+
+        // Mine the best package whole, ancestors first, until the next one would not fit
+        virtual void buildBlock(uint32_t maxBytes, BlockTemplate &out) final
+        {
+            out.clear();
+            while (!mHeap.empty())
+            {
+                const PackageEntry &best = mHeap.best();
+                uint32_t handle = best.mHandle;
+                float feeRate = best.mFeeRate;
+                if ((out.mBlockSize + mStore.getLink(handle).mAncestorSize) > maxBytes)
+                {
+                    break;
+                }
+                // Package fee rates go up and down as ancestors are mined, so track the lowest
+                if (out.mTransactionCount == 0 || feeRate < out.mMinFeeRate)
+                {
+                    out.mMinFeeRate = feeRate;
+                }
+                mChain.clear();
+                for (uint32_t a = handle; a != PACKAGE_NONE; a = mStore.getLink(a).mParent)
+                {
+                    mChain.push_back(a);
+                }
+                for (size_t i = mChain.size(); i-- != 0;)
+                {
+                    uint32_t h = mChain[i];
+                    out.mTransactionCount++;
+                    out.mBlockSize += mStore.getSize(h);
+                    out.mBlockFees += mStore.getFee(h);
+                    out.mBlockValue += mStore.getValue(h);
+                    mineRoot(h);
+                }
+            }
+            mTotalFees -= out.mBlockFees;
+            mTotalValue -= out.mBlockValue;
+            mMemPoolSize -= out.mBlockSize;
+        }
+
+        virtual void getFeeRateHistogram(FeeRateHistogram &h) const final
+        {
+            mStore.getFeeRateHistogram(h);
+        }
+
+        virtual void getSnapshot(uint32_t timeStamp, float cutoffFeeRate, MemPoolSnapshot &s) const final
+        {
+            mStore.getSnapshot(timeStamp, cutoffFeeRate, s);
+        }
+
+        virtual void addToSnapshot(SnapshotBuilder &b) const final
+        {
+            mStore.addToSnapshot(b);
+        }
+
+        virtual uint32_t getMemPoolSize(void) const final
+        {
+            return mMemPoolSize;
+        }
+
+        virtual uint32_t getMemPoolCount(void) const final
+        {
+            return mHeap.size();
+        }
+
+        virtual int64_t getMemPoolTotalValue(void) const final
+        {
+            return mTotalValue;
+        }
+
+        virtual int64_t getMemPoolTotalFees(void) const final
+        {
+            return mTotalFees;
+        }
+
+        virtual uint32_t getExpiredCount(void) const final
+        {
+            return mExpiredCount;
+        }
+
+        virtual uint64_t getExpiredSize(void) const final
+        {
+            return mExpiredSize;
+        }
+
+        virtual int64_t getExpiredFees(void) const final
+        {
+            return mExpiredFees;
+        }
+
+        virtual uint32_t getEvictedCount(void) const final
+        {
+            return mEvictedCount;
+        }
+
+        virtual uint64_t getEvictedSize(void) const final
+        {
+            return mEvictedSize;
+        }
+
+        virtual int64_t getEvictedFees(void) const final
+        {
+            return mEvictedFees;
+        }
+
+        virtual uint32_t getReplacedCount(void) const final
+        {
+            return mReplacedCount;
+        }
+
+        virtual float getMinFeeRate(uint32_t timeStamp) const final
+        {
+            return mMinFeeRate.get(timeStamp);
+        }
+
+        virtual void release(void) final
+        {
+            delete this;
+        }
+
+        // called by the heap every time an entry moves
+        void setIndex(const PackageEntry &e, uint32_t index)
+        {
+            mStore.getLink(e.mHandle).mHeapIndex = index;
+        }
+
+    protected:
+        uint32_t findParent(uint32_t parentID) const
+        {
+            uint32_t ret = PACKAGE_NONE;
+            if (parentID)
+            {
+                ret = mStore.find(parentID);
+                ret = ret == STORE_INVALID_SLOT ? PACKAGE_NONE : ret;
+            }
+            return ret;
+        }
+
+        // would a new child of 'parent' keep every package within the limits
+        bool withinLimits(uint32_t parent) const
+        {
+            if (parent == PACKAGE_NONE)
+            {
+                return true;
+            }
+            if (mStore.getLink(parent).mAncestorCount + 1 > PACKAGE_MAX_ANCESTORS)
+            {
+                return false;
+            }
+            for (uint32_t a = parent; a != PACKAGE_NONE; a = mStore.getLink(a).mParent)
+            {
+                if (mStore.getLink(a).mDescendantCount + 1 > PACKAGE_MAX_DESCENDANTS)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        uint32_t getRoot(uint32_t handle) const
+        {
+            while (mStore.getLink(handle).mParent != PACKAGE_NONE)
+            {
+                handle = mStore.getLink(handle).mParent;
+            }
+            return handle;
+        }
+
+        // the heap entry for a transaction, keyed by its package fee rate
+        PackageEntry getEntry(uint32_t handle) const
+        {
+            const PackageLink &l = mStore.getLink(handle);
+            PackageEntry e;
+            e.mFeeRate = l.mAncestorSize ? float(double(l.mAncestorFees) / double(l.mAncestorSize)) : 0.0f;
+            e.mID = mStore.getID(handle);
+            e.mHandle = handle;
+            return e;
+        }
+
+        // every pending descendant of 'handle', not counting itself, into mFamily
+        void collectDescendants(uint32_t handle)
+        {
+            mFamily.clear();
+            mStack.clear();
+            mStack.push_back(handle);
+            while (!mStack.empty())
+            {
+                uint32_t h = mStack.back();
+                mStack.pop_back();
+                for (uint32_t c = mStore.getLink(h).mFirstChild; c != PACKAGE_NONE; c = mStore.getLink(c).mNextSibling)
+                {
+                    mFamily.push_back(c);
+                    mStack.push_back(c);
+                }
+            }
+        }
+
+        // Take out a transaction with no pending parent.  Its descendants drop it from their package totals
+        // and are re-keyed; its children become roots.  The mempool totals are left to the caller.
+        void mineRoot(uint32_t root)
+        {
+            NV_ASSERT(mStore.getLink(root).mParent == PACKAGE_NONE);
+            uint32_t size = mStore.getSize(root);
+            uint32_t fee = mStore.getFee(root);
+            collectDescendants(root);
+            for (uint32_t d : mFamily)
+            {
+                PackageLink &l = mStore.getLink(d);
+                if (l.mParent == root)
+                {
+                    l.mParent = PACKAGE_NONE;
+                    l.mPrevSibling = PACKAGE_NONE;
+                    l.mNextSibling = PACKAGE_NONE;
+                }
+                l.mAncestorCount--;
+                l.mAncestorSize -= size;
+                l.mAncestorFees -= fee;
+                mHeap.update(l.mHeapIndex, getEntry(d));
+            }
+            unlink(root);
+        }
+
+        // Remove a transaction and all its descendants, which cannot stay without it, adding them to the given totals
+        void removeFamily(uint32_t handle, uint32_t &count, uint64_t &size, int64_t &fees)
+        {
+            PackageLink &l = mStore.getLink(handle);
+            for (uint32_t a = l.mParent; a != PACKAGE_NONE; a = mStore.getLink(a).mParent)
+            {
+                mStore.getLink(a).mDescendantCount -= l.mDescendantCount;
+            }
+            if (l.mParent != PACKAGE_NONE)
+            {
+                // detach from the parent's list of children
+                if (l.mPrevSibling != PACKAGE_NONE)
+                {
+                    mStore.getLink(l.mPrevSibling).mNextSibling = l.mNextSibling;
+                }
+                else
+                {
+                    mStore.getLink(l.mParent).mFirstChild = l.mNextSibling;
+                }
+                if (l.mNextSibling != PACKAGE_NONE)
+                {
+                    mStore.getLink(l.mNextSibling).mPrevSibling = l.mPrevSibling;
+                }
+            }
+            collectDescendants(handle);
+            mFamily.push_back(handle);
+            for (uint32_t h : mFamily)
+            {
+                uint32_t s = mStore.getSize(h);
+                uint32_t f = mStore.getFee(h);
+                count++;
+                size += s;
+                fees += f;
+                mTotalFees -= f;
+                mTotalValue -= mStore.getValue(h);
+                mMemPoolSize -= s;
+                unlink(h);
+            }
+            NV_ASSERT(mTotalValue >= 0);
+            NV_ASSERT(mTotalFees >= 0);
+        }
+
+        // drop the package with the lowest fee rate, with its descendants, and raise the minimum fee rate above it
+        void evictPackage(uint32_t timeStamp)
+        {
+            const PackageEntry &e = mHeap.worst();
+            mMinFeeRate.raise(e.mFeeRate, timeStamp);
+            removeFamily(e.mHandle, mEvictedCount, mEvictedSize, mEvictedFees);
+        }
+
+        // take a transaction out of the heap and the store; the family links are the caller's to fix
+        void unlink(uint32_t handle)
+        {
+            mHeap.remove(mStore.getLink(handle).mHeapIndex);
+            mStore.remove(handle);
+        }
+
+        uint32_t                                        mId;
+        uint32_t                                        mMemPoolSize;
+        int64_t                                         mTotalValue;
+        int64_t                                         mTotalFees;
+        uint32_t                                        mExpirySeconds;
+        uint32_t                                        mExpiredCount;
+        uint64_t                                        mExpiredSize;
+        int64_t                                         mExpiredFees;
+        uint32_t                                        mMaxSize;
+        uint32_t                                        mEvictedCount;
+        uint64_t                                        mEvictedSize;
+        int64_t                                         mEvictedFees;
+        RollingMinFeeRate                               mMinFeeRate;
+        MinMaxHeap< PackageEntry, MemPoolPackageImpl >  mHeap;
+        TransactionStore< PackageLink >                 mStore;
+        TimingWheel< PackageExpiry >                    mExpiry;
+        HandleVector                                    mChain;     // scratch: a package from the best entry up to its root
+        HandleVector                                    mFamily;    // scratch: descendants being re-keyed or removed
+        HandleVector                                    mStack;
+        uint32_t                                        mReplacedCount;
+    };
+
+    MemPool *createMemPoolPackage(uint32_t expirySeconds, uint32_t maxSize)
+    {
+        MemPoolPackageImpl *m = NV_NEW(MemPoolPackageImpl)(expirySeconds, maxSize);
+        return static_cast<MemPool *>(m);
+    }
+
+} // end of blockchainsim namespace
@@ -0,0 +1,380 @@
+#include "MemPool.h"
+#include "Transaction.h"
+#include "TransactionStore.h"
+#include "FeeRate.h"
+#include "NsUserAllocated.h"
+#include "NvAssert.h"
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#pragma warning(disable:4100)
+
+// A mempool split into shards that can be used from several threads at once.  Each transaction
+// is hashed by its ID to one shard: a min-max heap mempool behind its own lock, so producers
+// adding to different shards never wait on each other.
+// Block assembly locks every shard and does a k-way merge over the shard heads, which selects
+// transactions in exactly the order a single min-max heap would.  A size cap is split evenly
+// between the shards and each evicts its own lowest fee-rate transactions.
+
+namespace blockchainsim
+{
+
+    MemPool *createMemPoolMinMax(uint32_t expirySeconds, uint32_t maxSize);
+
+    class MemPoolShard : public UserAllocated
+    {
+    public:
+        std::mutex  mLock;
+        MemPool     *mMemPool;
+    };
+
+    typedef std::vector< MemPoolShard * > MemPoolShardVector;
+
+    // the best pending transaction of one shard
+    class ShardHead
+    {
+    public:
+        float       mFeeRate;
+        uint32_t    mID;
+        uint32_t    mSize;
+        uint32_t    mShard;
+    };
+
+    typedef std::vector< ShardHead > ShardHeadVector;
+
+    // Heap order for the merge; the same order as the min-max heap mempool, highest fee rate first and oldest first on ties
+    static bool isWorse(const ShardHead &a, const ShardHead &b)
+    {
+        if (a.mFeeRate != b.mFeeRate)
+        {
+            return a.mFeeRate < b.mFeeRate;
+        }
+        return a.mID > b.mID;
+    }
+
+    class MemPoolShardedImpl : public MemPool, public UserAllocated
+    {
+    public:
+        MemPoolShardedImpl(uint32_t expirySeconds, uint32_t maxSize, uint32_t shardCount)
+        {
+            if (shardCount == 0)
+            {
+                shardCount = std::thread::hardware_concurrency();
+                if (shardCount == 0)
+                {
+                    shardCount = 1;
+                }
+            }
+            uint32_t shardSize = 0;
+            if (maxSize)
+            {
+                shardSize = maxSize / shardCount;
+                shardSize = shardSize ? shardSize : 1;
+            }
+            mId.store(0);
+            mShards.resize(shardCount);
+            for (uint32_t i = 0; i < shardCount; i++)
+            {
+                mShards[i] = NV_NEW(MemPoolShard);
+                mShards[i]->mMemPool = createMemPoolMinMax(expirySeconds, shardSize);
+            }
+        }
+
+        virtual ~MemPoolShardedImpl(void)
+        {
+            for (auto &s : mShards)
+            {
+                s->mMemPool->release();
+                delete s;
+            }
+        }
+
+        virtual void pump(uint32_t timeStamp) final
+        {
+            for (auto &s : mShards)
+            {
+                std::lock_guard< std::mutex > lock(s->mLock);
+                s->mMemPool->pump(timeStamp);
+            }
+        }
+
+        // safe to call from any number of threads at once
+        virtual void addTransaction(const Transaction &_t, uint32_t parentID) final
+        {
+            Transaction t = _t;
+            t.mID = t.mID ? t.mID : ++mId;
+            MemPoolShard *s = mShards[getShard(t.mID)];
+            std::lock_guard< std::mutex > lock(s->mLock);
+            s->mMemPool->addTransaction(t, parentID);
+        }
+
+        // the replacement carries the original's ID, so it hashes to the original's shard
+        virtual bool replaceTransaction(const Transaction &t) final
+        {
+            MemPoolShard *s = mShards[getShard(t.mID)];
+            std::lock_guard< std::mutex > lock(s->mLock);
+            return s->mMemPool->replaceTransaction(t);
+        }
+
+        virtual void addTransactions(const Transaction *t, uint32_t count, const uint32_t *parentIDs) final
+        {
+            for (uint32_t i = 0; i < count; i++)
+            {
+                addTransaction(t[i], parentIDs ? parentIDs[i] : 0);
+            }
+        }
+
+        // peek the transaction with the highest fee rate across every shard; but don't remove it yet.
+        virtual bool peekTransaction(Transaction &t) final
+        {
+            lockAll();
+            bool ret = findBest(t) != mShards.size();
+            unlockAll();
+            return ret;
+        }
+
+        // get the transaction with the highest fee rate across every shard
+        virtual bool getTransaction(Transaction &t) final
+        {
+            bool ret = false;
+            lockAll();
+            size_t shard = findBest(t);
+            if (shard != mShards.size())
+            {
+                mShards[shard]->mMemPool->getTransaction(t);
+                ret = true;
+            }
+            unlockAll();
+            return ret;
+        }
+
+        // k-way merge: a heap of each shard's best transaction; taking one from a shard puts that shard's next in its place
+        virtual void buildBlock(uint32_t maxBytes, BlockTemplate &out) final
+        {
+            out.clear();
+            lockAll();
+            mHeads.clear();
+            for (uint32_t i = 0; i < uint32_t(mShards.size()); i++)
+            {
+                pushHead(i);
+            }
+            while (!mHeads.empty())
+            {
+                std::pop_heap(mHeads.begin(), mHeads.end(), isWorse);
+                ShardHead h = mHeads.back();
+                mHeads.pop_back();
+                if ((out.mBlockSize + h.mSize) > maxBytes)
+                {
+                    break;
+                }
+                Transaction t;
+                mShards[h.mShard]->mMemPool->getTransaction(t);
+                NV_ASSERT(t.mID == h.mID);
+                out.mMinFeeRate = h.mFeeRate;       // merged in fee rate order, so the last one is the lowest
+                out.mTransactionCount++;
+                out.mBlockSize += t.mTransactionSize;
+                out.mBlockFees += t.mFee;
+                out.mBlockValue += t.mValue;
+                pushHead(h.mShard);
+            }
+            unlockAll();
+        }
+
+        virtual void getFeeRateHistogram(FeeRateHistogram &h) const final
+        {
+            h.clear();
+            for (auto &s : mShards)
+            {
+                FeeRateHistogram shard;
+                {
+                    std::lock_guard< std::mutex > lock(s->mLock);
+                    s->mMemPool->getFeeRateHistogram(shard);
+                }
+                for (uint32_t i = 0; i < FEE_RATE_BUCKETS; i++)
+                {
+                    h.mCount[i] += shard.mCount[i];
+                    h.mBytes[i] += shard.mBytes[i];
+                }
+            }
+        }
+
+        virtual void getSnapshot(uint32_t timeStamp, float cutoffFeeRate, MemPoolSnapshot &s) const final
+        {
+            SnapshotBuilder b(timeStamp, cutoffFeeRate);
+            addToSnapshot(b);
+            b.finish(s);
+        }
+
+        virtual void addToSnapshot(SnapshotBuilder &b) const final
+        {
+            for (auto &s : mShards)
+            {
+                std::lock_guard< std::mutex > lock(s->mLock);
+                s->mMemPool->addToSnapshot(b);
+            }
+        }
+
+        virtual uint32_t getMemPoolSize(void) const final
+        {
+            return sum(&MemPool::getMemPoolSize);
+        }
+
+        virtual uint32_t getMemPoolCount(void) const final
+        {
+            return sum(&MemPool::getMemPoolCount);
+        }
+
+        virtual int64_t getMemPoolTotalValue(void) const final
+        {
+            return sum(&MemPool::getMemPoolTotalValue);
+        }
+
+        virtual int64_t getMemPoolTotalFees(void) const final
+        {
+            return sum(&MemPool::getMemPoolTotalFees);
+        }
+
+        virtual uint32_t getExpiredCount(void) const final
+        {
+            return sum(&MemPool::getExpiredCount);
+        }
+
+        virtual uint64_t getExpiredSize(void) const final
+        {
+            return sum(&MemPool::getExpiredSize);
+        }
+
+        virtual int64_t getExpiredFees(void) const final
+        {
+            return sum(&MemPool::getExpiredFees);
+        }
+
+        virtual uint32_t getEvictedCount(void) const final
+        {
+            return sum(&MemPool::getEvictedCount);
+        }
+
+        virtual uint64_t getEvictedSize(void) const final
+        {
+            return sum(&MemPool::getEvictedSize);
+        }
+
+        virtual int64_t getEvictedFees(void) const final
+        {
+            return sum(&MemPool::getEvictedFees);
+        }
+
+        virtual uint32_t getReplacedCount(void) const final
+        {
+            return sum(&MemPool::getReplacedCount);
+        }
+
+        // the highest of the shards' minimum fee rates; a transaction paying that is accepted by any shard
+        virtual float getMinFeeRate(uint32_t timeStamp) const final
+        {
+            float ret = 0;
+            for (auto &s : mShards)
+            {
+                std::lock_guard< std::mutex > lock(s->mLock);
+                float feeRate = s->mMemPool->getMinFeeRate(timeStamp);
+                ret = feeRate > ret ? feeRate : ret;
+            }
+            return ret;
+        }
+
+        virtual void release(void) final
+        {
+            delete this;
+        }
+
+    private:
+        // Consecutive IDs are spread across the shards by a multiplicative hash
+        uint32_t getShard(uint32_t id) const
+        {
+            return uint32_t((id * 2654435761u) % uint32_t(mShards.size()));
+        }
+
+        // always in shard order, so two threads locking everything cannot deadlock
+        void lockAll(void)
+        {
+            for (auto &s : mShards)
+            {
+                s->mLock.lock();
+            }
+        }
+
+        void unlockAll(void)
+        {
+            for (auto &s : mShards)
+            {
+                s->mLock.unlock();
+            }
+        }
+
+        // with every shard locked; returns the index of the shard holding the best transaction, or the shard count if all are empty
+        size_t findBest(Transaction &t)
+        {
+            size_t ret = mShards.size();
+            bool found = false;
+            ShardHead best = {};
+            for (size_t i = 0; i < mShards.size(); i++)
+            {
+                Transaction head;
+                if (mShards[i]->mMemPool->peekTransaction(head))
+                {
+                    ShardHead h;
+                    h.mFeeRate = getFeeRate(head.mFee, head.mTransactionSize);
+                    h.mID = head.mID;
+                    if (!found || isWorse(best, h))
+                    {
+                        found = true;
+                        best = h;
+                        t = head;
+                        ret = i;
+                    }
+                }
+            }
+            return ret;
+        }
+
+        void pushHead(uint32_t shard)
+        {
+            Transaction t;
+            if (mShards[shard]->mMemPool->peekTransaction(t))
+            {
+                ShardHead h;
+                h.mFeeRate = getFeeRate(t.mFee, t.mTransactionSize);
+                h.mID = t.mID;
+                h.mSize = t.mTransactionSize;
+                h.mShard = shard;
+                mHeads.push_back(h);
+                std::push_heap(mHeads.begin(), mHeads.end(), isWorse);
+            }
+        }
+
+        template< class R > R sum(R (MemPool::*get)(void) const) const
+        {
+            R ret = 0;
+            for (auto &s : mShards)
+            {
+                std::lock_guard< std::mutex > lock(s->mLock);
+                ret += (s->mMemPool->*get)();
+            }
+            return ret;
+        }
+
+        std::atomic< uint32_t > mId;
+        MemPoolShardVector      mShards;
+        ShardHeadVector         mHeads;         // scratch for the merge in buildBlock
+    };
+
+    MemPool *createMemPoolSharded(uint32_t expirySeconds, uint32_t maxSize, uint32_t shardCount)
+    {
+        MemPoolShardedImpl *m = NV_NEW(MemPoolShardedImpl)(expirySeconds, maxSize, shardCount);
+        return static_cast<MemPool *>(m);
+    }
+
+} // end of blockchainsim namespace
@@ -0,0 +1,220 @@
+#ifndef MIN_MAX_HEAP_H
+#define MIN_MAX_HEAP_H
+
+// A binary min-max heap: levels alternate between 'best' levels (the root's) and 'worst' levels,
+// so both the best entry (the root) and the worst entry (one of the root's children) can be
+// found in O(1) and removed in O(log n).  T supplies 'bool isBetter(const T &) const'; Tracker
+// supplies 'void setIndex(const T &, uint32_t)' and is told every time an entry moves, so an
+// entry can be removed from anywhere by index.
+
+#include <stdint.h>
+#include <vector>
+#include "FeeRate.h"
+
+namespace blockchainsim
+{
+
+    #define HEAP_NO_INDEX 0xFFFFFFFF
+
+    template< class T, class Tracker > class MinMaxHeap
+    {
+    public:
+        MinMaxHeap(Tracker &tracker) : mTracker(tracker)
+        {
+        }
+
+        bool empty(void) const
+        {
+            return mHeap.empty();
+        }
+
+        uint32_t size(void) const
+        {
+            return uint32_t(mHeap.size());
+        }
+
+        const T &operator[](uint32_t index) const
+        {
+            return mHeap[index];
+        }
+
+        const T &best(void) const
+        {
+            return mHeap[0];
+        }
+
+        const T &worst(void) const
+        {
+            return mHeap[getWorstIndex()];
+        }
+
+        void push(const T &e)
+        {
+            mHeap.push_back(e);
+            pushUp(uint32_t(mHeap.size() - 1), false);
+        }
+
+        void popBest(void)
+        {
+            removeAt(0);
+        }
+
+        void popWorst(void)
+        {
+            removeAt(getWorstIndex());
+        }
+
+        // remove the entry at 'index', wherever it sits
+        void remove(uint32_t index)
+        {
+            // Treat it as the most extreme entry of its own kind of level; that floats it along its
+            // grandparents to the root or to one of the root's children, where it can be popped
+            index = pushUp(index, true);
+            removeAt(index);
+        }
+
+        // Give the entry at 'index' a new key, better or worse, in place.  Sifting down restores its
+        // subtree; an entry that became more extreme than an ancestor of the other kind of level then
+        // rests on that kind of level, and sifting up from there puts it above that ancestor.  O(log n)
+        void update(uint32_t index, const T &e)
+        {
+            set(index, e);
+            pushUp(pushDown(index), false);
+        }
+
+    private:
+        static bool isBestLevel(uint32_t index)
+        {
+            return (getHighestBit(uint64_t(index) + 1) & 1) == 0;
+        }
+
+        uint32_t getWorstIndex(void) const
+        {
+            uint32_t count = uint32_t(mHeap.size());
+            if (count < 3)
+            {
+                return count - 1;
+            }
+            return mHeap[2].isBetter(mHeap[1]) ? 1 : 2;
+        }
+
+        void set(uint32_t index, const T &e)
+        {
+            mHeap[index] = e;
+            mTracker.setIndex(e, index);
+        }
+
+        // on a best level 'a' belongs above 'b' if it is better; on a worst level if it is worse
+        static bool beats(const T &a, const T &b, bool best)
+        {
+            return best ? a.isBetter(b) : b.isBetter(a);
+        }
+
+        // Returns the index the entry came to rest at.  'extreme' makes the entry win every comparison
+        // against its grandparents, without ever crossing to the other kind of level.
+        uint32_t pushUp(uint32_t index, bool extreme)
+        {
+            T e = mHeap[index];
+            bool best = isBestLevel(index);
+            if (index > 0 && !extreme)
+            {
+                uint32_t parent = (index - 1) / 2;
+                // belongs on the other kind of level; swap with the parent and continue from there
+                if (beats(e, mHeap[parent], !best))
+                {
+                    set(index, mHeap[parent]);
+                    index = parent;
+                    best = !best;
+                }
+            }
+            while (index > 2)
+            {
+                uint32_t grandParent = ((index - 1) / 2 - 1) / 2;
+                if (!extreme && !beats(e, mHeap[grandParent], best))
+                {
+                    break;
+                }
+                set(index, mHeap[grandParent]);
+                index = grandParent;
+            }
+            set(index, e);
+            return index;
+        }
+
+        // Returns the index the entry that started at 'index' came to rest at
+        uint32_t pushDown(uint32_t index)
+        {
+            T e = mHeap[index];
+            bool best = isBestLevel(index);
+            uint32_t count = uint32_t(mHeap.size());
+            uint32_t ret = HEAP_NO_INDEX;
+            for (;;)
+            {
+                uint32_t child = index * 2 + 1;
+                if (child >= count)
+                {
+                    break;
+                }
+                // the most extreme of the children and grandchildren
+                uint32_t m = child;
+                if (child + 1 < count && beats(mHeap[child + 1], mHeap[m], best))
+                {
+                    m = child + 1;
+                }
+                uint32_t grandChild = child * 2 + 1;
+                uint32_t end = grandChild + 4 < count ? grandChild + 4 : count;
+                for (uint32_t g = grandChild; g < end; g++)
+                {
+                    if (beats(mHeap[g], mHeap[m], best))
+                    {
+                        m = g;
+                    }
+                }
+                if (!beats(mHeap[m], e, best))
+                {
+                    break;
+                }
+                set(index, mHeap[m]);
+                index = m;
+                if (m < grandChild)
+                {
+                    break;      // swapped with a child, whose own subtree is already in order
+                }
+                uint32_t parent = (m - 1) / 2;
+                if (beats(e, mHeap[parent], !best))
+                {
+                    T p = mHeap[parent];
+                    set(parent, e);
+                    if (ret == HEAP_NO_INDEX)
+                    {
+                        ret = parent;
+                    }
+                    e = p;
+                }
+            }
+            set(index, e);
+            return ret == HEAP_NO_INDEX ? index : ret;
+        }
+
+        void removeAt(uint32_t index)
+        {
+            uint32_t last = uint32_t(mHeap.size() - 1);
+            if (index != last)
+            {
+                mHeap[index] = mHeap[last];
+                mHeap.pop_back();
+                pushDown(index);
+            }
+            else
+            {
+                mHeap.pop_back();
+            }
+        }
+
+        Tracker             &mTracker;
+        std::vector< T >    mHeap;
+    };
+
+} // end of blockchainsim namespace
+
+#endif
@@ -0,0 +1,218 @@
+#include "MonteCarlo.h"
+#include "BlockChain.h"
+#include "TaskPool.h"
+#include "Transaction.h"
+#include "NsUserAllocated.h"
+#include "logging.h"
+#include "NsRand.h"
+#include <stdio.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+
+#ifdef _MSC_VER
+#pragma warning(disable:4996)
+#endif
+
+namespace blockchainsim
+{
+
+    typedef std::vector< BlockInfo > BlockInfoVector;
+    typedef std::vector< double > DoubleVector;
+
+    // One independent simulation; owns its BlockChain (and through it the MemPool and Population)
+    class MonteCarloRun : public Task
+    {
+    public:
+        MonteCarloRun(void) : mSettings(nullptr), mStartTime(0)
+        {
+        }
+
+        virtual void execute(void) final
+        {
+            BlockChain *b = BlockChain::create(*mSettings, mStartTime, mRandom, false);
+            if (b)
+            {
+                while (b->pump())
+                {
+                }
+                uint32_t count;
+                const BlockInfo *blocks = b->getBlocks(count);
+                mBlocks.assign(blocks, blocks + count);
+                b->release();
+            }
+        }
+
+        const SimulationSettings    *mSettings;
+        uint32_t                    mStartTime;
+        Rand                        mRandom;            // independent random stream for this run
+        BlockInfoVector             mBlocks;
+    };
+
+    typedef std::vector< MonteCarloRun > MonteCarloRunVector;
+
+    // The statistics merged into confidence bands, in report column order
+    enum Metric
+    {
+        M_BLOCK_TIME,
+        M_TRANSACTION_COUNT,
+        M_BLOCK_FEES,
+        M_MEMPOOL_COUNT,
+        M_MEMPOOL_SIZE,
+        M_MEMPOOL_FEES,
+        M_LAST
+    };
+
+    static const char *gMetricNames[M_LAST] =
+    {
+        "BlockTime",
+        "TransactionCount",
+        "BlockFees",
+        "MemPoolCount",
+        "MemPoolSize",
+        "MemPoolFees",
+    };
+
+    static double getMetric(const BlockInfo &b, Metric m)
+    {
+        double ret = 0;
+        switch (m)
+        {
+            case M_BLOCK_TIME:          ret = double(b.mBlockTime) / 60.0; break;
+            case M_TRANSACTION_COUNT:   ret = double(b.mTransactionCount); break;
+            case M_BLOCK_FEES:          ret = double(b.mBlockFees) / double(SATOSHIS_PER_BITCOIN); break;
+            case M_MEMPOOL_COUNT:       ret = double(b.mMemPoolCount); break;
+            case M_MEMPOOL_SIZE:        ret = double(b.mMemPoolSize); break;
+            case M_MEMPOOL_FEES:        ret = double(b.mMemPoolFees) / double(SATOSHIS_PER_BITCOIN); break;
+            case M_LAST:                break;
+        }
+        return ret;
+    }
+
+    // Nearest-rank percentile of an already sorted sample
+    static double getPercentile(const DoubleVector &sorted, double p)
+    {
+        size_t index = size_t(p * double(sorted.size() - 1) + 0.5);
+        return sorted[index];
+    }
+
+    class MonteCarloImpl : public MonteCarlo, public UserAllocated
+    {
+    public:
+        MonteCarloImpl(const SimulationSettings &s, uint32_t runCount, uint32_t threadCount) : mSettings(s)
+        {
+            mRunCount = runCount;
+            mThreadCount = threadCount;
+        }
+
+        virtual ~MonteCarloImpl(void)
+        {
+        }
+
+        virtual bool run(void) final
+        {
+            if (mRunCount == 0)
+            {
+                return false;
+            }
+            // Every run starts on the same simulated date so their blocks line up
+            time_t t;
+            time(&t);
+            MonteCarloRunVector runs(mRunCount);
+            TaskPool *pool = TaskPool::create(mThreadCount);
+            logMessage("Running %d simulations on %d threads\n", mRunCount, pool->getThreadCount());
+            // Each run gets the stream after the last, one long jump on, rather than jumping from the start every time
+            Rand stream;
+            stream.setSeed(SIMULATION_SEED, 0);
+            for (uint32_t i = 0; i < mRunCount; i++)
+            {
+                runs[i].mSettings = &mSettings;
+                runs[i].mStartTime = uint32_t(t);
+                runs[i].mRandom = stream;
+                stream.longJump();
+                pool->submit(&runs[i]);
+            }
+            pool->wait();
+            pool->release();
+            return writeReport(runs);
+        }
+
+        bool writeReport(const MonteCarloRunVector &runs)
+        {
+            FILE *fph = fopen("MonteCarlo.csv", "wb");
+            if (fph == nullptr)
+            {
+                logMessage(LL_ERROR, "Failed to open MonteCarlo.csv for write access\n");
+                return false;
+            }
+            fprintf(fph, "Block,Runs");
+            for (uint32_t m = 0; m < M_LAST; m++)
+            {
+                const char *name = gMetricNames[m];
+                fprintf(fph, ",%sMean,%sP05,%sP50,%sP95", name, name, name, name);
+            }
+            fprintf(fph, "\r\n");
+
+            size_t blockCount = 0;
+            for (auto &r : runs)
+            {
+                blockCount = std::max(blockCount, r.mBlocks.size());
+            }
+
+            DoubleVector samples;
+            samples.reserve(runs.size());
+            for (size_t i = 0; i < blockCount; i++)
+            {
+                uint32_t runCount = 0;
+                for (auto &r : runs)
+                {
+                    if (i < r.mBlocks.size())
+                    {
+                        runCount++;
+                    }
+                }
+                fprintf(fph, "%d,%d", uint32_t(i + 1), runCount);
+                for (uint32_t m = 0; m < M_LAST; m++)
+                {
+                    samples.clear();
+                    double total = 0;
+                    for (auto &r : runs)
+                    {
+                        if (i < r.mBlocks.size())
+                        {
+                            double v = getMetric(r.mBlocks[i], Metric(m));
+                            samples.push_back(v);
+                            total += v;
+                        }
+                    }
+                    std::sort(samples.begin(), samples.end());
+                    fprintf(fph, ",%f,%f,%f,%f", total / double(samples.size()),
+                        getPercentile(samples, 0.05),
+                        getPercentile(samples, 0.50),
+                        getPercentile(samples, 0.95));
+                }
+                fprintf(fph, "\r\n");
+            }
+            fclose(fph);
+            logMessage("Wrote confidence bands for %d blocks from %d runs to MonteCarlo.csv\n", uint32_t(blockCount), uint32_t(runs.size()));
+            return true;
+        }
+
+        virtual void release(void) final
+        {
+            delete this;
+        }
+
+    protected:
+        const SimulationSettings    &mSettings;
+        uint32_t                    mRunCount;
+        uint32_t                    mThreadCount;
+    };
+
+    MonteCarlo *MonteCarlo::create(const SimulationSettings &s, uint32_t runCount, uint32_t threadCount)
+    {
+        MonteCarloImpl *m = NV_NEW(MonteCarloImpl)(s, runCount, threadCount);
+        return static_cast<MonteCarlo *>(m);
+    }
+
+} // end of blockchainsim namespace
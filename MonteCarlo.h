@@ -0,0 +1,32 @@
+#ifndef MONTE_CARLO_H
+#define MONTE_CARLO_H
+
+#include <stdint.h>
+
+// Runs many independent seeds of the blockchain simulation across a thread pool and merges
+// their per-block statistics into confidence bands written to MonteCarlo.csv
+
+namespace blockchainsim
+{
+
+    class SimulationSettings;
+
+    class MonteCarlo
+    {
+    public:
+        // 'runCount' independent simulations are executed on 'threadCount' threads (zero means one per core)
+        static MonteCarlo *create(const SimulationSettings &s, uint32_t runCount, uint32_t threadCount);
+
+        // Run every simulation to completion and write the merged report; returns false on failure
+        virtual bool run(void) = 0;
+
+        virtual void release(void) = 0;
+    protected:
+        virtual ~MonteCarlo(void)
+        {
+        }
+    };
+
+} // end of blockchainsim namespace
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef MPSC_RING_H
+#define MPSC_RING_H
+
+// A bounded lock-free ring for many producer threads and a single consumer thread.  Every cell
+// carries a sequence number that says whose turn it is: a producer claims a cell by advancing
+// the shared head with a compare-exchange, writes the value and then publishes it by bumping the
+// cell's sequence; the consumer reads cells in order and hands each back to the producers by
+// bumping its sequence one lap further.  Entries from any one producer come out in the order
+// that producer pushed them.
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+namespace blockchainsim
+{
+
+    #define MPSC_CACHE_LINE 64
+
+    template< class T > class MpscRing
+    {
+    public:
+        // the capacity is rounded up to a power of two
+        MpscRing(uint32_t capacity) : mCells(getRingSize(capacity))
+        {
+            uint32_t size = uint32_t(mCells.size());
+            mMask = size - 1;
+            for (uint32_t i = 0; i < size; i++)
+            {
+                mCells[i].mSequence.store(i, std::memory_order_relaxed);
+            }
+            mHead.store(0, std::memory_order_relaxed);
+            mTail = 0;
+        }
+
+        // any thread; returns false if the ring is full
+        bool push(const T &value)
+        {
+            uint32_t pos = mHead.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                Cell &c = mCells[pos & mMask];
+                uint32_t seq = c.mSequence.load(std::memory_order_acquire);
+                int32_t diff = int32_t(seq - pos);
+                if (diff == 0)
+                {
+                    // the cell is free for this lap; try to claim it
+                    if (mHead.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        c.mValue = value;
+                        c.mSequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false;       // the consumer has not yet taken the value from a lap ago
+                }
+                else
+                {
+                    pos = mHead.load(std::memory_order_relaxed);    // another producer claimed it first
+                }
+            }
+        }
+
+        // consumer thread only; returns false if the ring is empty
+        bool pop(T &value)
+        {
+            Cell &c = mCells[mTail & mMask];
+            uint32_t seq = c.mSequence.load(std::memory_order_acquire);
+            if (seq != mTail + 1)
+            {
+                return false;
+            }
+            value = c.mValue;
+            c.mSequence.store(mTail + mMask + 1, std::memory_order_release);
+            mTail++;
+            return true;
+        }
+
+        // consumer thread only; pops up to 'maxCount' values and returns how many it got
+        uint32_t popBatch(T *values, uint32_t maxCount)
+        {
+            uint32_t ret = 0;
+            while (ret < maxCount && pop(values[ret]))
+            {
+                ret++;
+            }
+            return ret;
+        }
+
+        uint32_t getCapacity(void) const
+        {
+            return mMask + 1;
+        }
+
+    private:
+        class Cell
+        {
+        public:
+            std::atomic< uint32_t > mSequence;
+            T                       mValue;
+        };
+
+        typedef std::vector< Cell > CellVector;
+
+        static uint32_t getRingSize(uint32_t capacity)
+        {
+            uint32_t size = 2;
+            while (size < capacity)
+            {
+                size <<= 1;
+            }
+            return size;
+        }
+
+        // the producers' and the consumer's positions are kept on separate cache lines
+        char                    mPad0[MPSC_CACHE_LINE];
+        std::atomic< uint32_t > mHead;      // next position a producer will claim
+        char                    mPad1[MPSC_CACHE_LINE];
+        uint32_t                mTail;      // next position the consumer will read
+        uint32_t                mMask;
+        CellVector              mCells;
+        char                    mPad2[MPSC_CACHE_LINE];
+    };
+
+} // end of blockchainsim namespace
+
+#endif
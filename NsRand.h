@@ -13,25 +13,41 @@
 
 namespace blockchainsim
 {
+        // xoshiro256** by Blackman and Vigna.  Every generator owns its own 256 bits of state, so
+        // simulation instances never contend on shared state.  'jump' advances the sequence by 2^128
+        // and 'longJump' by 2^192 which is how independent, non-overlapping streams are handed out.
         class Rand
         {
         public:
 
             Rand(int32_t seed = 0)
             {
-                mCurrent = seed;
+                setSeed(seed);
             };
 
+            uint64_t get64(void)
+            {
+                uint64_t result = rotl(mState[1] * 5, 7) * 9;
+                uint64_t t = mState[1] << 17;
+                mState[2] ^= mState[0];
+                mState[3] ^= mState[1];
+                mState[1] ^= mState[2];
+                mState[0] ^= mState[3];
+                mState[2] ^= t;
+                mState[3] = rotl(mState[3], 45);
+                return result;
+            }
+
+            // random non-negative 31 bit integer
             int32_t get(void)
             {
-                return((mCurrent = mCurrent * 214013L + 2531011L) & 0x7fffffff);
+                return int32_t(get64() >> 33);
             };
 
-            // random number between 0.0 and 1.0
+            // random number between 0.0 and 1.0 with the full 24 bits of float mantissa resolution
             float ranf(void)
             {
-                int32_t v = get() & 0x7FFF;
-                return (float)v*(1.0f / 32767.0f);
+                return float(get64() >> 40)*(1.0f / 16777216.0f);
             };
 
             float ranf(float low, float high)
@@ -41,11 +57,73 @@ namespace blockchainsim
 
             void setSeed(int32_t seed)
             {
-                mCurrent = seed;
+                setSeed(uint64_t(uint32_t(seed)), 0);
             };
 
+            // Seed the generator and select one of 2^64 independent streams of length 2^192.  Stream
+            // 'stream' costs that many long jumps; to hand out a run of streams, seed once and copy
+            // the generator between long jumps.
+            void setSeed(uint64_t seed, uint64_t stream)
+            {
+                // splitmix64 expands the seed into a well mixed initial state
+                for (uint32_t i = 0; i < 4; i++)
+                {
+                    seed += 0x9E3779B97F4A7C15ULL;
+                    uint64_t z = seed;
+                    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                    mState[i] = z ^ (z >> 31);
+                }
+                for (uint64_t i = 0; i < stream; i++)
+                {
+                    longJump();
+                }
+            }
+
+            // Equivalent to 2^128 calls to get64; used to hand out non-overlapping sub-streams
+            void jump(void)
+            {
+                static const uint64_t table[4] = { 0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL, 0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL };
+                applyJump(table);
+            }
+
+            // Equivalent to 2^192 calls to get64; used to give each simulation instance its own stream
+            void longJump(void)
+            {
+                static const uint64_t table[4] = { 0x76E15D3EFEFDCBBFULL, 0xC5004E441C522FB3ULL, 0x77710069854EE241ULL, 0x39109BB02ACBE635ULL };
+                applyJump(table);
+            }
+
         private:
-            int32_t mCurrent;
+            static uint64_t rotl(uint64_t x, int32_t k)
+            {
+                return (x << k) | (x >> (64 - k));
+            }
+
+            void applyJump(const uint64_t *table)
+            {
+                uint64_t s[4] = { 0, 0, 0, 0 };
+                for (uint32_t i = 0; i < 4; i++)
+                {
+                    for (uint32_t b = 0; b < 64; b++)
+                    {
+                        if (table[i] & (uint64_t(1) << b))
+                        {
+                            s[0] ^= mState[0];
+                            s[1] ^= mState[1];
+                            s[2] ^= mState[2];
+                            s[3] ^= mState[3];
+                        }
+                        get64();
+                    }
+                }
+                mState[0] = s[0];
+                mState[1] = s[1];
+                mState[2] = s[2];
+                mState[3] = s[3];
+            }
+
+            uint64_t mState[4];
         };
 
         class RandPool
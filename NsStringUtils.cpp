@@ -153,68 +153,79 @@ const char * skipWhitespace(const char *str)
     return str;
 }
 
-#define MAXNUMERIC 32  // JWR  support up to 16 32 character long numeric formated strings
-#define MAXFNUM    16
-
-static  char  gFormat[MAXNUMERIC*MAXFNUM];
-static int32_t    gIndex = 0;
-
-const char * formatNumber(int32_t number) // JWR  format this integer into a fancy comma delimited string
+static const char gDigitPairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// two digits at a time from the right, so one division per pair rather than per digit
+uint32_t formatDecimal(uint64_t number, char *dst)
 {
-    char * dest = &gFormat[gIndex*MAXNUMERIC];
-    gIndex++;
-    if (gIndex == MAXFNUM) gIndex = 0;
-
-    char scratch[512];
-    blockchainsim::stringFormat(scratch, 512, "%d", number);
-
-    char *source = scratch;
-    char *str = dest;
-    uint32_t len = (uint32_t)strlen(scratch);
-    if (scratch[0] == '-')
+    char temp[24];
+    char *p = temp + sizeof(temp);
+    while (number >= 100)
     {
-        *str++ = '-';
-        source++;
-        len--;
+        uint32_t pair = uint32_t(number % 100) * 2;
+        number /= 100;
+        *--p = gDigitPairs[pair + 1];
+        *--p = gDigitPairs[pair];
     }
-    for (uint32_t i = 0; i < len; i++)
+    if (number >= 10)
     {
-        int32_t place = (len - 1) - i;
-        *str++ = source[i];
-        if (place && (place % 3) == 0) *str++ = ',';
+        *--p = gDigitPairs[number * 2 + 1];
+        *--p = gDigitPairs[number * 2];
     }
-    *str = 0;
-
-    return dest;
+    else
+    {
+        *--p = char('0' + number);
+    }
+    uint32_t len = uint32_t(temp + sizeof(temp) - p);
+    memcpy(dst, p, len);
+    return len;
 }
 
-const char * formatUnsignedNumber(uint32_t number) // JWR  format this integer into a fancy comma delimited string
+// the digits of 'number' with a comma before every group of three; returns the length
+static uint32_t formatGrouped(uint64_t number, char *dst)
 {
-    char * dest = &gFormat[gIndex*MAXNUMERIC];
-    gIndex++;
-    if (gIndex == MAXFNUM) gIndex = 0;
-
-    char scratch[512];
-    blockchainsim::stringFormat(scratch, 512, "%u", number);
+    char digits[24];
+    uint32_t len = formatDecimal(number, digits);
+    uint32_t group = len % 3 ? len % 3 : 3;     // digits before the first comma
+    memcpy(dst, digits, group);
+    char *str = dst + group;
+    for (uint32_t i = group; i < len; i += 3)
+    {
+        *str++ = ',';
+        str[0] = digits[i];
+        str[1] = digits[i + 1];
+        str[2] = digits[i + 2];
+        str += 3;
+    }
+    return uint32_t(str - dst);
+}
 
-    char *source = scratch;
-    char *str = dest;
-    uint32_t len = (uint32_t)strlen(scratch);
-    if (scratch[0] == '-')
+const char * formatNumber(int64_t number, char *dst)
+{
+    char *str = dst;
+    if (number < 0)
     {
         *str++ = '-';
-        source++;
-        len--;
-    }
-    for (uint32_t i = 0; i < len; i++)
-    {
-        int32_t place = (len - 1) - i;
-        *str++ = source[i];
-        if (place && (place % 3) == 0) *str++ = ',';
     }
+    str += formatGrouped(number < 0 ? uint64_t(0) - uint64_t(number) : uint64_t(number), str);
     *str = 0;
+    return dst;
+}
 
-    return dest;
+const char * formatUnsignedNumber(uint64_t number, char *dst)
+{
+    dst[formatGrouped(number, dst)] = 0;
+    return dst;
 }
 
 
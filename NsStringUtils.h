@@ -44,8 +44,15 @@ bool isWhitespace(char c);
 // Skip to next non-whitespace character or EOS
 const char * skipWhitespace(const char *str);
 
-const char * formatNumber(int32_t number);
-const char * formatUnsignedNumber(uint32_t number);
+#define FORMAT_NUMBER_SIZE 32   // room for any 64 bit number with its sign, commas and terminator
+
+// The decimal digits of 'number' with no terminator; returns the length
+uint32_t formatDecimal(uint64_t number, char *dst);
+
+// Comma grouped ("-1,234,567") into 'dst', which holds FORMAT_NUMBER_SIZE bytes; returns 'dst'.
+// Nothing is shared between calls, so these are safe from any thread.
+const char * formatNumber(int64_t number, char *dst);
+const char * formatUnsignedNumber(uint64_t number, char *dst);
 
 // Case inensitive string compare
 bool striCmp(const char *a, const char *b);
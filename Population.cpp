@@ -1,28 +1,50 @@
 #include "Population.h"
 #include "Transaction.h"
-#include "MemPool.h"
+#include "DemandCurve.h"
 #include "NsUserAllocated.h"
 #include "gauss.h"
 #include "NvAssert.h"
-#include <time.h>
+#include <vector>
+#include <deque>
 
 #pragma warning(disable:4100)
 
 namespace blockchainsim
 {
 
-class MemPool;
+#define RECENT_PARENTS 256      // how many of the latest transactions a child may spend from
+
+typedef std::vector< Transaction > TransactionVector;
+typedef std::vector< float > FloatVector;
+typedef std::vector< uint32_t > UIntVector;
+typedef std::deque< Transaction > TransactionQueue;
 
 class PopulationImpl : public Population, public UserAllocated
 {
 public:
-    PopulationImpl(void)
+    PopulationImpl(Rand &seedSource, const PopulationDesc &desc, uint32_t index, uint32_t count) : mDemand(desc.mHasHourlyRates ? DemandCurve(desc.mHourlyRates) : DemandCurve())
     {
-        mTransactionPendingCount = 0;
-        mTransactionsPerSecond.Set("20:10<0:60>");
-        mAverageFee.Set("0.04:0.011<0:0.25>");
-        mAverageValue.Set("8:10<0.01:1000>");
-        mAverageSize.Set("550:150<250:1000>");
+        mNextID = index + 1;
+        mIDStride = count;
+        mChildShare = desc.mChildShare;
+        mBumpWait = desc.mBumpWait;
+        mBumpFactor = desc.mBumpFactor;
+        mRecentCount = 0;
+        mTransactionsPerSecond = desc.mTransactionsPerSecond;
+        mAverageFee = desc.mFee;
+        mAverageValue = desc.mValue;
+        mAverageSize = desc.mSize;
+        // Give every distribution its own reproducible random sequence
+        mTransactionsPerSecond.srand(seedSource);
+        mAverageFee.srand(seedSource);
+        mAverageValue.srand(seedSource);
+        mAverageSize.srand(seedSource);
+        // Only take a stream for parent choice when it is used, so every other sequence stays as it was
+        if (mChildShare > 0)
+        {
+            mParentRandom = seedSource;
+            seedSource.jump();
+        }
     }
 
     virtual ~PopulationImpl(void)
@@ -31,39 +53,110 @@ public:
     }
 
 	// process once per logical second
-    virtual bool pump(uint32_t timeStamp, MemPool *mp)
+    virtual bool pump(uint32_t timeStamp, TransactionSink *sink)
     {
         bool ret = true;
 
-        time_t t(timeStamp);
-        struct tm *gtm = gmtime(&t);
-        if (gtm->tm_hour >= 8 && gtm->tm_hour <= 12)
+        if (!mBumps.empty())
+        {
+            issueBumps(timeStamp, sink);
+        }
+        float demand = mDemand.getRate(timeStamp);
+        if (demand > 0)
         {
-            mTransactionPendingCount += mTransactionsPerSecond.Get();
-            if (mTransactionPendingCount > 1.0f)
+            // The arrival rate for this second is itself random, so the count is drawn from
+            // the compound Gauss/Poisson distribution and the whole batch is filled in one pass.
+            float rate = mTransactionsPerSecond.Get() * demand;
+            uint32_t count = randPoisson(mTransactionsPerSecond, rate);
+            if (count)
             {
-                uint32_t count = uint32_t(mTransactionPendingCount);
-                mTransactionPendingCount -= float(count);
-                for (uint32_t i = 0; i < count; i++)
-                {
-                    generateTransaction(mp, timeStamp);
-                }
+                generateTransactions(sink, timeStamp, count);
             }
         }
 
         return ret;
     }
 
-    void generateTransaction(MemPool *p,uint32_t timeStamp)
+    virtual uint32_t getNextActiveTime(uint32_t timeStamp) const
     {
-        Transaction t;
-        t.mFee              = mAverageFee.Get();
-        t.mValue            = mAverageValue.Get();
-        t.mTransactionSize  = uint32_t(mAverageSize.Get());
-        t.mTimestamp        = timeStamp;
-        NV_ASSERT(t.mFee >= 0);
-        NV_ASSERT(t.mValue >= 0);
-        p->addTransaction(t);
+        uint32_t ret = mDemand.getNextActiveTime(timeStamp);
+        // a fee bump falls due even while the wallets are otherwise quiet
+        if (!mBumps.empty())
+        {
+            uint32_t bump = mBumps.front().mTimestamp + mBumpWait;
+            bump = bump > timeStamp ? bump : timeStamp;
+            ret = bump < ret ? bump : ret;
+        }
+        return ret;
+    }
+
+    // Re-issue every transaction that has waited out the bump delay at a higher fee.  The wallet cannot
+    // see the mempool; a bump for a transaction that was already mined or dropped is simply turned away.
+    void issueBumps(uint32_t timeStamp, TransactionSink *sink)
+    {
+        mBumpBatch.clear();
+        while (!mBumps.empty() && mBumps.front().mTimestamp + mBumpWait <= timeStamp)
+        {
+            Transaction t = mBumps.front();
+            mBumps.pop_front();
+            double fee = double(t.mFee) * mBumpFactor + 0.5;
+            t.mFee = fee < 4294967295.0 ? uint32_t(fee) : 0xFFFFFFFF;
+            t.mTimestamp = timeStamp;
+            t.mTransactionSize |= TF_REPLACEMENT;
+            mBumpBatch.push_back(t);
+        }
+        if (!mBumpBatch.empty())
+        {
+            sink->addTransactions(&mBumpBatch[0], uint32_t(mBumpBatch.size()), nullptr);
+        }
+    }
+
+    void generateTransactions(TransactionSink *sink, uint32_t timeStamp, uint32_t count)
+    {
+        if (mBatch.size() < count)
+        {
+            mBatch.resize(count);
+            mFees.resize(count);
+            mValues.resize(count);
+            mSizes.resize(count);
+            mParents.resize(count);
+        }
+        // Sample each distribution for the whole batch at once, then interleave into the records
+        mAverageFee.GetBatch(&mFees[0], count);
+        mAverageValue.GetBatch(&mValues[0], count);
+        mAverageSize.GetBatch(&mSizes[0], count);
+        Transaction *batch = &mBatch[0];
+        for (uint32_t i = 0; i < count; i++)
+        {
+            Transaction &t = batch[i];
+            NV_ASSERT(mFees[i] >= 0);
+            NV_ASSERT(mValues[i] >= 0);
+            // the distributions are in bitcoin; round to whole satoshis, saturating as a bumped fee does
+            double fee = double(mFees[i]) * SATOSHIS_PER_BITCOIN + 0.5;
+            t.mFee              = fee < 4294967295.0 ? uint32_t(fee) : 0xFFFFFFFF;
+            t.mValue            = int64_t(double(mValues[i]) * SATOSHIS_PER_BITCOIN + 0.5);
+            t.mTransactionSize  = mSizes[i] < float(TF_SIZE_MASK) ? uint32_t(mSizes[i]) : TF_SIZE_MASK;
+            t.mTimestamp        = timeStamp;
+            t.mID               = mNextID;
+            mNextID            += mIDStride;
+            if (mChildShare > 0)
+            {
+                // Some transactions spend an output of one of the latest transactions
+                mParents[i] = 0;
+                if (mRecentCount && mParentRandom.ranf() < mChildShare)
+                {
+                    uint32_t recent = mRecentCount < RECENT_PARENTS ? mRecentCount : RECENT_PARENTS;
+                    mParents[i] = mRecent[uint32_t(mParentRandom.get()) % recent];
+                }
+                mRecent[mRecentCount % RECENT_PARENTS] = t.mID;
+                mRecentCount++;
+            }
+            if (mBumpWait)
+            {
+                mBumps.push_back(t);
+            }
+        }
+        sink->addTransactions(batch, count, mChildShare > 0 ? &mParents[0] : nullptr);
     }
 
 
@@ -73,16 +166,37 @@ public:
     }
 
 
-    float   mTransactionPendingCount;
+    DemandCurve         mDemand;                    // rate multiplier by minute of the week
     Gauss   mTransactionsPerSecond;
     Gauss   mAverageFee;
     Gauss   mAverageValue;
     Gauss   mAverageSize;
+    TransactionVector   mBatch;     // scratch storage for the transactions generated each second
+    FloatVector         mFees;      // scratch samples for the batch
+    FloatVector         mValues;
+    FloatVector         mSizes;
+    UIntVector          mParents;   // the parent each transaction in the batch spends from, when children are on
+    uint32_t            mNextID;
+    uint32_t            mIDStride;                  // how many cohorts share the ID space
+    float               mChildShare;                // fraction of transactions that spend a pending parent
+    Rand                mParentRandom;
+    uint32_t            mRecent[RECENT_PARENTS];    // ring of the latest transaction IDs
+    uint32_t            mRecentCount;
+    uint32_t            mBumpWait;                  // seconds before a wallet bumps the fee of a transaction; zero never
+    float               mBumpFactor;                // what the bumped fee is multiplied by
+    TransactionQueue    mBumps;                     // transactions waiting for their bump, oldest first
+    TransactionVector   mBumpBatch;
 };
 
-Population *Population::create(void)
+Population *createTraceReplayPopulation(const char *fname, uint32_t startTime, uint32_t index, uint32_t count);
+
+Population *Population::create(Rand &seedSource, const PopulationDesc &desc, uint32_t startTime, uint32_t index, uint32_t count)
 {
-    PopulationImpl *p = NV_NEW(PopulationImpl);
+    if (!desc.mTraceFile.empty())
+    {
+        return createTraceReplayPopulation(desc.mTraceFile.c_str(), startTime, index, count);
+    }
+    PopulationImpl *p = NV_NEW(PopulationImpl)(seedSource, desc, index, count);
     return static_cast<Population *>(p);
 }
 
@@ -2,20 +2,64 @@
 #define POPULATION_H
 
 #include <stdint.h>
+#include "gauss.h"
+#include "DemandCurve.h"
 
 namespace blockchainsim
 {
 
-class MemPool;
+class TransactionSink;
+class Rand;
+
+// Everything that sets one cohort of wallets apart: its distributions, its weekly demand and its habits
+class PopulationDesc
+{
+public:
+	// the built-in retail wallets
+	PopulationDesc(void) : mName("default")
+	{
+		mTransactionsPerSecond.Set("20:10<0:60>");
+		mFee.Set("0.04:0.011<0:0.25>");
+		mValue.Set("8:10<0.01:1000>");
+		mSize.Set("550:150<250:1000>");
+		mHasHourlyRates = false;
+		for (uint32_t i = 0; i < DEMAND_HOURS_PER_WEEK; i++)
+		{
+			mHourlyRates[i] = 0;
+		}
+		mChildShare = 0;
+		mBumpWait = 0;
+		mBumpFactor = 2;
+	}
+
+	String		mName;
+	String		mTraceFile;					// replay this recorded trace instead of generating transactions (see TraceReplayPopulation.cpp)
+	Gauss		mTransactionsPerSecond;
+	Gauss		mFee;						// bitcoin
+	Gauss		mValue;						// bitcoin
+	Gauss		mSize;						// bytes
+	bool		mHasHourlyRates;			// without, busy from 08:00 to 12:59 UTC every day
+	float		mHourlyRates[DEMAND_HOURS_PER_WEEK];	// rate multipliers from Sunday 00:00 UTC (see DemandCurve.h)
+	float		mChildShare;				// fraction of transactions that spend an output of a recent one
+	uint32_t	mBumpWait;					// seconds a transaction waits before it is replaced by a higher fee; zero never
+	float		mBumpFactor;				// what a bumped fee is multiplied by
+};
 
 class Population
 {
 public:
-	static Population *create(void);
+	// Every random sequence the population uses is drawn as a sub-stream of 'seedSource'.  Cohort 'index'
+	// of 'count' numbers its transactions index+1, index+1+count, ... so IDs never collide between cohorts.
+	// A replayed trace starts at 'startTime'.  Returns nullptr if the trace cannot be read.
+	static Population *create(Rand &seedSource, const PopulationDesc &desc, uint32_t startTime, uint32_t index = 0, uint32_t count = 1);
+
 
+	// process once per logical second; the transactions generated are handed to 'sink'
+	virtual bool pump(uint32_t timeStamp,TransactionSink *sink) = 0;
 
-	// process once per logical second
-	virtual bool pump(uint32_t timeStamp,MemPool *mp) = 0;
+	// returns the first logical second at or after 'timeStamp' in which this population
+	// will generate transactions; lets the simulation skip idle periods entirely
+	virtual uint32_t getNextActiveTime(uint32_t timeStamp) const = 0;
 
 
 	virtual void release(void) = 0;
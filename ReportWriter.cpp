@@ -0,0 +1,312 @@
+#include "ReportWriter.h"
+#include "NsUserAllocated.h"
+#include "Transaction.h"
+#include "NsStringUtils.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+#include <vector>
+
+#pragma warning(disable:4996)
+
+namespace blockchainsim
+{
+
+    #define REPORT_FIELD_SIZE 64        // room always left for one formatted number and its comma
+    #define REPORT_BUFFER_COUNT 4       // buffers that may exist at once; a disk that falls behind stalls the report, not memory
+
+    typedef std::vector< char > CharVector;
+
+    class ReportBuffer : public UserAllocated
+    {
+    public:
+        CharVector  mData;
+        uint32_t    mUsed;
+    };
+
+    typedef std::deque< ReportBuffer * > ReportBufferQueue;
+    typedef std::vector< ReportBuffer * > ReportBufferVector;
+
+    // exactly 'width' digits, zero padded on the left
+    static void formatPadded(char *dst, uint64_t v, uint32_t width)
+    {
+        for (uint32_t i = width; i-- != 0;)
+        {
+            dst[i] = char('0' + v % 10);
+            v /= 10;
+        }
+    }
+
+    // Writes 'v' as printf's "%f" does, rounding the exact binary value to six places with ties to
+    // even; returns the length, or zero for anything too large or not finite, which is left to printf
+    static uint32_t formatFixed(char *dst, double v)
+    {
+        if (!(v > -1e12 && v < 1e12))
+        {
+            return 0;
+        }
+        char *p = dst;
+        if (signbit(v))
+        {
+            *p++ = '-';
+            v = -v;
+        }
+        double whole = floor(v);
+        double frac = v - whole;                        // exact
+        double scaled = frac * 1e6;
+        double error = fma(frac, 1e6, -scaled);         // what the product lost to rounding, exactly
+        double micros = nearbyint(scaled);
+        // 'scaled' is within half a unit of its true value, so only an apparent tie can round the other way
+        double d = scaled - micros;
+        if (d == 0.5 && error > 0)
+        {
+            micros += 1;
+        }
+        else if (d == -0.5 && error < 0)
+        {
+            micros -= 1;
+        }
+        uint64_t w = uint64_t(whole);
+        uint64_t m = uint64_t(micros);
+        if (m == 1000000)
+        {
+            w++;
+            m = 0;
+        }
+        p += formatDecimal(w, p);
+        *p++ = '.';
+        formatPadded(p, m, 6);
+        p += 6;
+        return uint32_t(p - dst);
+    }
+
+    class ReportWriterImpl : public ReportWriter, public UserAllocated
+    {
+    public:
+        ReportWriterImpl(FILE *fph, uint32_t flushSeconds, uint32_t bufferSize)
+        {
+            mFile = fph;
+            mFlushInterval = std::chrono::seconds(flushSeconds);
+            mBufferSize = bufferSize > (REPORT_FIELD_SIZE * 2) ? bufferSize : (REPORT_FIELD_SIZE * 2);
+            mStop = false;
+            mFill = getBuffer();
+            mBufferCount = 1;
+            mLastFlush = std::chrono::steady_clock::now();
+            mThread = std::thread(&ReportWriterImpl::writerThread, this);
+        }
+
+        virtual ~ReportWriterImpl(void)
+        {
+            flush();
+            {
+                std::lock_guard< std::mutex > lock(mLock);
+                mStop = true;
+            }
+            mSignal.notify_one();
+            mThread.join();
+            fclose(mFile);
+            delete mFill;
+            for (auto &b : mFree)
+            {
+                delete b;
+            }
+        }
+
+        virtual void addText(const char *text) final
+        {
+            uint32_t len = uint32_t(strlen(text));
+            char *p = reserve(len);
+            memcpy(p, text, len);
+            mFill->mUsed += len;
+        }
+
+        virtual void addString(const char *str) final
+        {
+            uint32_t len = uint32_t(strlen(str));
+            char *p = reserve(len + 1);
+            memcpy(p, str, len);
+            p[len] = ',';
+            mFill->mUsed += len + 1;
+        }
+
+        virtual void addInt(int64_t v) final
+        {
+            char *p = reserve(REPORT_FIELD_SIZE);
+            char *start = p;
+            if (v < 0)
+            {
+                *p++ = '-';
+            }
+            p += formatDecimal(v < 0 ? uint64_t(0) - uint64_t(v) : uint64_t(v), p);
+            *p++ = ',';
+            mFill->mUsed += uint32_t(p - start);
+        }
+
+        virtual void addUnsigned(uint64_t v) final
+        {
+            char *p = reserve(REPORT_FIELD_SIZE);
+            uint32_t len = formatDecimal(v, p);
+            p[len] = ',';
+            mFill->mUsed += len + 1;
+        }
+
+        virtual void addFloat(double v) final
+        {
+            char *p = reserve(REPORT_FIELD_SIZE);
+            uint32_t len = formatFixed(p, v);
+            if (len == 0)
+            {
+                char temp[512];
+                snprintf(temp, sizeof(temp), "%f", v);
+                addString(temp);
+                return;
+            }
+            p[len] = ',';
+            mFill->mUsed += len + 1;
+        }
+
+        virtual void addBitcoin(int64_t satoshis) final
+        {
+            char *p = reserve(REPORT_FIELD_SIZE);
+            char *start = p;
+            uint64_t v = uint64_t(satoshis < 0 ? -satoshis : satoshis);
+            if (satoshis < 0)
+            {
+                *p++ = '-';
+            }
+            p += formatDecimal(v / SATOSHIS_PER_BITCOIN, p);
+            *p++ = '.';
+            formatPadded(p, v % SATOSHIS_PER_BITCOIN, 8);
+            p += 8;
+            *p++ = ',';
+            mFill->mUsed += uint32_t(p - start);
+        }
+
+        virtual void endRow(void) final
+        {
+            char *p = reserve(2);
+            p[0] = '\r';
+            p[1] = '\n';
+            mFill->mUsed += 2;
+            if (mFlushInterval.count() && (std::chrono::steady_clock::now() - mLastFlush) >= mFlushInterval)
+            {
+                flush();
+            }
+        }
+
+        virtual void flush(void) final
+        {
+            mLastFlush = std::chrono::steady_clock::now();
+            if (mFill->mUsed)
+            {
+                std::unique_lock< std::mutex > lock(mLock);
+                mFull.push_back(mFill);
+                mSignal.notify_one();
+                // once every buffer has been made, wait for the writer thread to hand one back
+                if (mFree.empty() && mBufferCount == REPORT_BUFFER_COUNT)
+                {
+                    mSignal.wait(lock, [this] { return !mFree.empty(); });
+                }
+                mFill = takeFree();
+                if (!mFill)
+                {
+                    mBufferCount++;
+                    lock.unlock();
+                    mFill = getBuffer();
+                }
+            }
+        }
+
+        virtual void release(void) final
+        {
+            delete this;
+        }
+
+    private:
+        // room for 'len' more bytes at the end of the buffer being filled
+        char *reserve(uint32_t len)
+        {
+            if (mFill->mUsed + len > uint32_t(mFill->mData.size()))
+            {
+                flush();
+                if (len > uint32_t(mFill->mData.size()))
+                {
+                    mFill->mData.resize(len);
+                }
+            }
+            return &mFill->mData[mFill->mUsed];
+        }
+
+        ReportBuffer *getBuffer(void)
+        {
+            ReportBuffer *b = NV_NEW(ReportBuffer);
+            b->mData.resize(mBufferSize);
+            b->mUsed = 0;
+            return b;
+        }
+
+        // with the lock held
+        ReportBuffer *takeFree(void)
+        {
+            ReportBuffer *ret = nullptr;
+            if (!mFree.empty())
+            {
+                ret = mFree.back();
+                mFree.pop_back();
+            }
+            return ret;
+        }
+
+        void writerThread(void)
+        {
+            std::unique_lock< std::mutex > lock(mLock);
+            for (;;)
+            {
+                mSignal.wait(lock, [this] { return mStop || !mFull.empty(); });
+                if (mFull.empty())
+                {
+                    break;      // stopped, and everything handed over is written
+                }
+                ReportBuffer *b = mFull.front();
+                mFull.pop_front();
+                lock.unlock();
+                fwrite(&b->mData[0], 1, b->mUsed, mFile);
+                fflush(mFile);
+                b->mUsed = 0;
+                lock.lock();
+                mFree.push_back(b);
+                mSignal.notify_one();
+            }
+        }
+
+        FILE                                    *mFile;
+        uint32_t                                mBufferSize;
+        std::chrono::steady_clock::duration     mFlushInterval;
+        std::chrono::steady_clock::time_point   mLastFlush;
+        ReportBuffer                            *mFill;         // being formatted into by the simulation
+        std::mutex                              mLock;          // guards everything below
+        uint32_t                                mBufferCount;   // buffers made so far, at most REPORT_BUFFER_COUNT
+        std::condition_variable                 mSignal;        // the writer waits on it for a full buffer, the simulation for a free one
+        bool                                    mStop;
+        ReportBufferQueue                       mFull;          // waiting to be written, oldest first
+        ReportBufferVector                      mFree;          // written and ready to be filled again
+        std::thread                             mThread;
+    };
+
+    ReportWriter *ReportWriter::create(const char *fname, uint32_t flushSeconds, uint32_t bufferSize)
+    {
+        FILE *fph = fopen(fname, "wb");
+        if (!fph)
+        {
+            return nullptr;
+        }
+        ReportWriterImpl *r = NV_NEW(ReportWriterImpl)(fph, flushSeconds, bufferSize);
+        return static_cast<ReportWriter *>(r);
+    }
+
+} // end of blockchainsim namespace
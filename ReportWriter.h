@@ -0,0 +1,51 @@
+#ifndef REPORT_WRITER_H
+#define REPORT_WRITER_H
+
+#include <stdint.h>
+
+// Writes a CSV report without stalling the simulation on the disk.  Rows are formatted straight
+// into a large memory buffer, with integer and fixed point formatters that skip printf, and a
+// full buffer is handed to a background thread that writes it out while the next one fills.
+// Only a few buffers are ever made, so if the disk falls behind the simulation waits for one.
+// A partly filled buffer is also handed over every so often, so the file can be followed while
+// a long simulation runs.
+
+namespace blockchainsim
+{
+
+    #define REPORT_BUFFER_SIZE (1024*1024)
+
+    class ReportWriter
+    {
+    public:
+        // Returns nullptr if 'fname' cannot be created.  A buffer goes to the writer thread when it is full,
+        // or at the end of a row once 'flushSeconds' have passed since the last one went (zero: only when full).
+        static ReportWriter *create(const char *fname, uint32_t flushSeconds, uint32_t bufferSize = REPORT_BUFFER_SIZE);
+
+        // copied to the report as is
+        virtual void addText(const char *text) = 0;
+
+        // Each of these appends one field and the comma after it
+        virtual void addString(const char *str) = 0;
+        virtual void addInt(int64_t v) = 0;
+        virtual void addUnsigned(uint64_t v) = 0;
+        virtual void addFloat(double v) = 0;                // exactly as printf's "%f" would
+        virtual void addBitcoin(int64_t satoshis) = 0;      // an exact bitcoin amount with eight decimal places
+
+        // ends the row with "\r\n"
+        virtual void endRow(void) = 0;
+
+        // hand everything formatted so far to the writer thread
+        virtual void flush(void) = 0;
+
+        // writes out everything still buffered and closes the file
+        virtual void release(void) = 0;
+    protected:
+        virtual ~ReportWriter(void)
+        {
+        }
+    };
+
+} // end of blockchainsim namespace
+
+#endif
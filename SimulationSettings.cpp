@@ -4,12 +4,19 @@
 #include "logging.h"
 #include "gauss.h"
 #include "UnitConversion.h"
+#include "Population.h"
 #include "NvAssert.h"
+#include "NsStringUtils.h"
+#include "NsString.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <vector>
 
 namespace blockchainsim
 {
 
+    typedef std::vector< PopulationDesc > PopulationDescVector;
+
     class SimulationSettingsImpl : public SimulationSettings, public KeyValueResource, public UserAllocated
     {
     public:
@@ -26,7 +33,7 @@ namespace blockchainsim
                     initProperties();
                     if (mError)
                     {
-                        logMessage("Failed to initialize the INI settings for '%s'\n", simName);
+                        logMessage(LL_ERROR, "Failed to initialize the INI settings for '%s'\n", simName);
                     }
                     else
                     {
@@ -35,13 +42,13 @@ namespace blockchainsim
                 }
                 else
                 {
-                    logMessage("Failed to create INI file '%s'\n", simName);
+                    logMessage(LL_ERROR, "Failed to create INI file '%s'\n", simName);
                 }
                 releaseIniResource(mem);
             }
             else
             {
-                logMessage("Failed to open INI file '%s'\n", simName);
+                logMessage(LL_ERROR, "Failed to open INI file '%s'\n", simName);
             }
         }
 
@@ -57,6 +64,469 @@ namespace blockchainsim
             getSize("BLOCKCHAIN", "MAX_BLOCK_SIZE", mMaxBlockSize);
             getSize("BLOCKCHAIN", "TRANSACTION_SIZE", mTransactionSize);
             getSize("BLOCKCHAIN", "BLOCK_COUNT", mBlockCount);
+            getMemPoolType("MEMPOOL", "MEMPOOL_TYPE", mMemPoolType);
+            getSeconds("MEMPOOL", "MEMPOOL_EXPIRY", mMemPoolExpiry);
+            getMemPoolMaxSize("MEMPOOL", "MEMPOOL_MAX_SIZE", mMemPoolMaxSize);
+            getMemPoolShards("MEMPOOL", "MEMPOOL_SHARDS", mMemPoolShards);
+            getIngestQueueSize("MEMPOOL", "MEMPOOL_INGEST_QUEUE", mIngestQueueSize);
+            getPopulations();
+            getLogSinks("LOG", "ERRORS", mLogSinks[LL_ERROR]);
+            getLogSinks("LOG", "WARNINGS", mLogSinks[LL_WARNING]);
+            getLogSinks("LOG", "INFO", mLogSinks[LL_INFO]);
+            getLogSinks("LOG", "PROGRESS", mLogSinks[LL_PROGRESS]);
+            getLogQuiet("LOG", "QUIET", mLogQuiet);
+            getReportFormat("REPORT", "FORMAT", mReportFormat);
+            // the report is handed to the disk at least once a second unless told otherwise
+            mReportFlushInterval = 1;
+            if (mINI->getKeyValue("REPORT", "FLUSH_INTERVAL"))
+            {
+                getSeconds("REPORT", "FLUSH_INTERVAL", mReportFlushInterval);
+            }
+        }
+
+        bool getLogSinks(const char *section, const char *key, uint32_t &sinks)
+        {
+            bool ret = true;
+
+            sinks = LS_CONSOLE | LS_FILE;
+            const char *value = mINI->getKeyValue(section, key);
+            if (value)
+            {
+                if (striCmp(value, "console"))
+                {
+                    sinks = LS_CONSOLE;
+                }
+                else if (striCmp(value, "file"))
+                {
+                    sinks = LS_FILE;
+                }
+                else if (striCmp(value, "both"))
+                {
+                    sinks = LS_CONSOLE | LS_FILE;
+                }
+                else if (striCmp(value, "none"))
+                {
+                    sinks = 0;
+                }
+                else
+                {
+                    logMessage(LL_ERROR, "ERROR: Unknown log destination '%s' for '%s'; expected 'console', 'file', 'both' or 'none'\n", value, key);
+                    mError = true;
+                    ret = false;
+                }
+            }
+
+            return ret;
+        }
+
+        bool getLogQuiet(const char *section, const char *key, bool &quiet)
+        {
+            bool ret = true;
+
+            quiet = false;
+            const char *value = mINI->getKeyValue(section, key);
+            if (value)
+            {
+                if (striCmp(value, "true"))
+                {
+                    quiet = true;
+                }
+                else if (!striCmp(value, "false"))
+                {
+                    logMessage(LL_ERROR, "ERROR: '%s' must be 'true' or 'false'; got '%s'\n", key, value);
+                    mError = true;
+                    ret = false;
+                }
+            }
+
+            return ret;
+        }
+
+        bool getReportFormat(const char *section, const char *key, uint32_t &format)
+        {
+            bool ret = true;
+
+            format = RF_CSV;
+            const char *value = mINI->getKeyValue(section, key);
+            if (value)
+            {
+                if (striCmp(value, "csv"))
+                {
+                    format = RF_CSV;
+                }
+                else if (striCmp(value, "binary"))
+                {
+                    format = RF_BINARY;
+                }
+                else if (striCmp(value, "both"))
+                {
+                    format = RF_CSV | RF_BINARY;
+                }
+                else
+                {
+                    logMessage(LL_ERROR, "ERROR: Unknown report format '%s' for '%s'; expected 'csv', 'binary' or 'both'\n", value, key);
+                    mError = true;
+                    ret = false;
+                }
+            }
+
+            return ret;
+        }
+
+        bool getMemPoolType(const char *section, const char *key, MemPoolType &type)
+        {
+            bool ret = true;
+
+            type = MPT_ORDERED_SET;
+            const char *value = mINI->getKeyValue(section, key);
+            if (value)
+            {
+                if (striCmp(value, "set"))
+                {
+                    type = MPT_ORDERED_SET;
+                }
+                else if (striCmp(value, "heap"))
+                {
+                    type = MPT_INDEXED_HEAP;
+                }
+                else if (striCmp(value, "buckets"))
+                {
+                    type = MPT_FEE_RATE_BUCKETS;
+                }
+                else if (striCmp(value, "minmax"))
+                {
+                    type = MPT_MIN_MAX_HEAP;
+                }
+                else if (striCmp(value, "sharded"))
+                {
+                    type = MPT_SHARDED;
+                }
+                else if (striCmp(value, "packages"))
+                {
+                    type = MPT_ANCESTOR_PACKAGES;
+                }
+                else
+                {
+                    logMessage(LL_ERROR, "ERROR: Unknown mempool type '%s' for '%s'; expected 'set', 'heap', 'buckets', 'minmax', 'sharded' or 'packages'\n", value, key);
+                    mError = true;
+                    ret = false;
+                }
+            }
+
+            return ret;
+        }
+
+        bool getSeconds(const char *section, const char *key, uint32_t &seconds)
+        {
+            bool ret = true;
+
+            seconds = 0;
+            const char *value = mINI->getKeyValue(section, key);
+            if (value)
+            {
+                Gauss g;
+                if (getGaussTime(value, g))
+                {
+                    seconds = uint32_t(g.GetMean());
+                }
+                else
+                {
+                    logMessage(LL_ERROR, "Failed to convert '%s' into a valid time for '%s'.\n", value, key);
+                    mError = true;
+                    ret = false;
+                }
+            }
+
+            return ret;
+        }
+
+        bool getMemPoolMaxSize(const char *section, const char *key, uint32_t &size)
+        {
+            bool ret = true;
+
+            size = 0;
+            const char *value = mINI->getKeyValue(section, key);
+            if (value)
+            {
+                Gauss g;
+                if (!getGaussSize(value, g))
+                {
+                    logMessage(LL_ERROR, "Failed to convert '%s' into a valid size for '%s'.\n", value, key);
+                    mError = true;
+                    ret = false;
+                }
+                else if (mMemPoolType == MPT_ORDERED_SET || mMemPoolType == MPT_INDEXED_HEAP)
+                {
+                    logMessage(LL_ERROR, "ERROR: '%s' needs a mempool type that can evict by fee rate; use 'buckets', 'minmax', 'sharded' or 'packages'\n", key);
+                    mError = true;
+                    ret = false;
+                }
+                else
+                {
+                    size = uint32_t(g.GetMean());
+                }
+            }
+
+            return ret;
+        }
+
+        bool getMemPoolShards(const char *section, const char *key, uint32_t &count)
+        {
+            bool ret = true;
+
+            count = 0;
+            const char *value = mINI->getKeyValue(section, key);
+            if (value)
+            {
+                Gauss g;
+                if (!getGaussSize(value, g))
+                {
+                    logMessage(LL_ERROR, "Failed to convert '%s' into a valid count for '%s'.\n", value, key);
+                    mError = true;
+                    ret = false;
+                }
+                else if (mMemPoolType != MPT_SHARDED)
+                {
+                    logMessage(LL_ERROR, "ERROR: '%s' only applies to the 'sharded' mempool type\n", key);
+                    mError = true;
+                    ret = false;
+                }
+                else
+                {
+                    count = uint32_t(g.GetMean());
+                }
+            }
+
+            return ret;
+        }
+
+        bool getIngestQueueSize(const char *section, const char *key, uint32_t &count)
+        {
+            bool ret = true;
+
+            count = 0;
+            const char *value = mINI->getKeyValue(section, key);
+            if (value)
+            {
+                Gauss g;
+                if (getGaussSize(value, g))
+                {
+                    count = uint32_t(g.GetMean());
+                }
+                else
+                {
+                    logMessage(LL_ERROR, "Failed to convert '%s' into a valid count for '%s'.\n", value, key);
+                    mError = true;
+                    ret = false;
+                }
+            }
+
+            return ret;
+        }
+
+        // One cohort per [POPULATION:<name>] section, in file order; without any, [POPULATION] describes the only one
+        bool getPopulations(void)
+        {
+            bool ret = true;
+
+            mPopulations.clear();
+            uint32_t count = mINI->getSectionCount();
+            for (uint32_t i = 0; i < count && ret; i++)
+            {
+                uint32_t keys;
+                uint32_t lineno;
+                const char *section = mINI->getSection(i, keys, lineno)->getSectionName();
+                if (blockchainsim::strnicmp(section, "POPULATION:", 11) == 0)
+                {
+                    PopulationDesc desc;
+                    desc.mName = section + 11;
+                    ret = getPopulation(section, desc);
+                    mPopulations.push_back(desc);
+                }
+            }
+            if (mPopulations.empty())
+            {
+                PopulationDesc desc;
+                ret = getPopulation("POPULATION", desc);
+                mPopulations.push_back(desc);
+            }
+
+            return ret;
+        }
+
+        bool getPopulation(const char *section, PopulationDesc &desc)
+        {
+            const char *trace = getPopulationKey(section, "TRACE_FILE");
+            if (trace)
+            {
+                desc.mTraceFile = trace;
+            }
+            return getPopulationGauss(section, "TRANSACTIONS_PER_SECOND", desc.mTransactionsPerSecond) &&
+                getPopulationGauss(section, "FEE", desc.mFee) &&
+                getPopulationGauss(section, "VALUE", desc.mValue) &&
+                getPopulationGauss(section, "SIZE", desc.mSize) &&
+                getHourlyRates(section, desc) &&
+                getChildShare(section, "CHILD_SHARE", desc.mChildShare) &&
+                getBumpWait(section, "BUMP_WAIT", desc.mBumpWait) &&
+                getBumpFactor(section, "BUMP_FACTOR", desc.mBumpFactor);
+        }
+
+        // a cohort's own key, else the one [POPULATION] sets for every cohort
+        const char *getPopulationKey(const char *section, const char *key)
+        {
+            const char *value = mINI->getKeyValue(section, key);
+            return value ? value : mINI->getKeyValue("POPULATION", key);
+        }
+
+        // optional; 'g' keeps its built-in distribution unless the key is set
+        bool getPopulationGauss(const char *section, const char *key, Gauss &g)
+        {
+            bool ret = true;
+
+            const char *value = getPopulationKey(section, key);
+            if (value && !getGaussSize(value, g))
+            {
+                logMessage(LL_ERROR, "Failed to convert '%s' into a valid Gaussian number for '%s' in '%s'.\n", value, key, section);
+                mError = true;
+                ret = false;
+            }
+
+            return ret;
+        }
+
+        // RATE_EVERY_DAY sets all seven days and RATE_SUNDAY to RATE_SATURDAY override single days; each is
+        // 24 comma separated rate multipliers from 00:00 UTC
+        bool getHourlyRates(const char *section, PopulationDesc &desc)
+        {
+            static const char *days[7] = { "RATE_SUNDAY", "RATE_MONDAY", "RATE_TUESDAY", "RATE_WEDNESDAY", "RATE_THURSDAY", "RATE_FRIDAY", "RATE_SATURDAY" };
+            bool ret = true;
+
+            desc.mHasHourlyRates = false;
+            const char *value = getPopulationKey(section, "RATE_EVERY_DAY");
+            if (value)
+            {
+                for (uint32_t d = 0; d < 7 && ret; d++)
+                {
+                    ret = getDayRates(value, "RATE_EVERY_DAY", &desc.mHourlyRates[d * 24]);
+                }
+                desc.mHasHourlyRates = true;
+            }
+            for (uint32_t d = 0; d < 7 && ret; d++)
+            {
+                value = getPopulationKey(section, days[d]);
+                if (value)
+                {
+                    if (!desc.mHasHourlyRates)
+                    {
+                        logMessage(LL_ERROR, "ERROR: '%s' overrides a day of RATE_EVERY_DAY, which is missing\n", days[d]);
+                        mError = true;
+                        return false;
+                    }
+                    ret = getDayRates(value, days[d], &desc.mHourlyRates[d * 24]);
+                }
+            }
+
+            return ret;
+        }
+
+        bool getDayRates(const char *value, const char *key, float *rates)
+        {
+            const char *scan = value;
+            for (uint32_t h = 0; h < 24; h++)
+            {
+                char *end;
+                rates[h] = strtof(scan, &end);
+                while (*end == ' ' || *end == '\t')
+                {
+                    end++;
+                }
+                if (end == scan || rates[h] < 0 || (h < 23 && *end != ','))
+                {
+                    logMessage(LL_ERROR, "ERROR: '%s' needs 24 comma separated rate multipliers that are not negative; got '%s'\n", key, value);
+                    mError = true;
+                    return false;
+                }
+                scan = *end == ',' ? end + 1 : end;
+            }
+            if (*scan)
+            {
+                logMessage(LL_ERROR, "ERROR: '%s' has more than 24 rate multipliers; got '%s'\n", key, value);
+                mError = true;
+                return false;
+            }
+            return true;
+        }
+
+        bool getChildShare(const char *section, const char *key, float &share)
+        {
+            bool ret = true;
+
+            share = 0;
+            const char *value = getPopulationKey(section, key);
+            if (value)
+            {
+                Gauss g;
+                if (getGaussSize(value, g) && g.GetMean() >= 0 && g.GetMean() <= 1)
+                {
+                    share = g.GetMean();
+                }
+                else
+                {
+                    logMessage(LL_ERROR, "Failed to convert '%s' into a fraction between 0 and 1 for '%s'.\n", value, key);
+                    mError = true;
+                    ret = false;
+                }
+            }
+
+            return ret;
+        }
+
+        bool getBumpWait(const char *section, const char *key, uint32_t &seconds)
+        {
+            bool ret = true;
+
+            seconds = 0;
+            const char *value = getPopulationKey(section, key);
+            if (value)
+            {
+                Gauss g;
+                if (getGaussTime(value, g))
+                {
+                    seconds = uint32_t(g.GetMean());
+                }
+                else
+                {
+                    logMessage(LL_ERROR, "Failed to convert '%s' into a valid time for '%s'.\n", value, key);
+                    mError = true;
+                    ret = false;
+                }
+            }
+
+            return ret;
+        }
+
+        bool getBumpFactor(const char *section, const char *key, float &factor)
+        {
+            bool ret = true;
+
+            factor = 2;
+            const char *value = getPopulationKey(section, key);
+            if (value)
+            {
+                Gauss g;
+                if (getGaussSize(value, g) && g.GetMean() > 1)
+                {
+                    factor = g.GetMean();
+                }
+                else
+                {
+                    logMessage(LL_ERROR, "Failed to convert '%s' into a fee multiplier greater than 1 for '%s'.\n", value, key);
+                    mError = true;
+                    ret = false;
+                }
+            }
+
+            return ret;
         }
 
         bool getTime(const char *section, const char *key,Gauss &g)
@@ -72,13 +542,13 @@ namespace blockchainsim
                 }
                 else
                 {
-                    logMessage("Failed to convert '%s' into a valid Gaussian number.\n", value);
+                    logMessage(LL_ERROR, "Failed to convert '%s' into a valid Gaussian number.\n", value);
                     mError = true;
                 }
             }
             else
             {
-                logMessage("ERROR: Failed to locate value for '%s' from section '%s'\n", key, section);
+                logMessage(LL_ERROR, "ERROR: Failed to locate value for '%s' from section '%s'\n", key, section);
                 mError = true;
             }
 
@@ -98,13 +568,13 @@ namespace blockchainsim
                 }
                 else
                 {
-                    logMessage("Failed to convert '%s' into a valid Gaussian number.\n", value);
+                    logMessage(LL_ERROR, "Failed to convert '%s' into a valid Gaussian number.\n", value);
                     mError = true;
                 }
             }
             else
             {
-                logMessage("ERROR: Failed to locate value for '%s' from section '%s'\n", key, section);
+                logMessage(LL_ERROR, "ERROR: Failed to locate value for '%s' from section '%s'\n", key, section);
                 mError = true;
             }
 
@@ -133,7 +603,7 @@ namespace blockchainsim
             }
             else
             {
-                logMessage("Failed to open resource file '%s'\n", resourceName);
+                logMessage(LL_ERROR, "Failed to open resource file '%s'\n", resourceName);
             }
 
             return ret;
@@ -177,6 +647,61 @@ namespace blockchainsim
             return mBlockCount;
         }
 
+        virtual MemPoolType getMemPoolType(void) const
+        {
+            return mMemPoolType;
+        }
+
+        virtual uint32_t getMemPoolExpiry(void) const
+        {
+            return mMemPoolExpiry;
+        }
+
+        virtual uint32_t getMemPoolMaxSize(void) const
+        {
+            return mMemPoolMaxSize;
+        }
+
+        virtual uint32_t getMemPoolShards(void) const
+        {
+            return mMemPoolShards;
+        }
+
+        virtual uint32_t getIngestQueueSize(void) const
+        {
+            return mIngestQueueSize;
+        }
+
+        virtual uint32_t getLogSinks(LogLevel level) const
+        {
+            return mLogSinks[level];
+        }
+
+        virtual bool getLogQuiet(void) const
+        {
+            return mLogQuiet;
+        }
+
+        virtual uint32_t getReportFormat(void) const
+        {
+            return mReportFormat;
+        }
+
+        virtual uint32_t getReportFlushInterval(void) const
+        {
+            return mReportFlushInterval;
+        }
+
+        virtual uint32_t getPopulationCount(void) const
+        {
+            return uint32_t(mPopulations.size());
+        }
+
+        virtual const PopulationDesc &getPopulation(uint32_t index) const
+        {
+            return mPopulations[index];
+        }
+
 
     protected:
         bool             mError;
@@ -185,6 +710,16 @@ namespace blockchainsim
         Gauss           mMaxBlockSize;
         Gauss           mTransactionSize;
         Gauss           mBlockCount;
+        MemPoolType     mMemPoolType;
+        uint32_t        mMemPoolExpiry;
+        uint32_t        mMemPoolMaxSize;
+        uint32_t        mMemPoolShards;
+        uint32_t        mIngestQueueSize;
+        PopulationDescVector mPopulations;
+        uint32_t        mLogSinks[LL_COUNT];
+        bool            mLogQuiet;
+        uint32_t        mReportFormat;
+        uint32_t        mReportFlushInterval;
     };
 
     SimulationSettings *SimulationSettings::create(const char *fname)
@@ -1,10 +1,21 @@
 #ifndef SIMULATION_SETTINGS_H
 #define SIMULATION_SETTINGS_H
 
+#include "MemPool.h"
+#include "logging.h"
+
 namespace blockchainsim
 {
 
     class Gauss;
+    class PopulationDesc;
+
+    // which files the per-block results are written to; a combination of flags
+    enum ReportFormat
+    {
+        RF_CSV      = (1<<0),       // BlockChain.csv
+        RF_BINARY   = (1<<1),       // BlockChain.bcol; a column file (see ColumnFile.h)
+    };
 
     class SimulationSettings
     {
@@ -22,6 +33,39 @@ namespace blockchainsim
 
         virtual const Gauss& getBlockCount(void) const = 0;
 
+        // which mempool implementation to simulate with (optional; defaults to the ordered set)
+        virtual MemPoolType getMemPoolType(void) const = 0;
+
+        // how many seconds a transaction may wait in the mempool before it is dropped (optional; zero means never)
+        virtual uint32_t getMemPoolExpiry(void) const = 0;
+
+        // the largest the mempool may grow in bytes before it starts evicting (optional; zero means unbounded)
+        virtual uint32_t getMemPoolMaxSize(void) const = 0;
+
+        // how many shards a sharded mempool is split into (optional; zero means one per hardware thread)
+        virtual uint32_t getMemPoolShards(void) const = 0;
+
+        // how many transactions the queue between the population threads and the mempool holds (optional;
+        // zero means the population is pumped inline on the simulation thread)
+        virtual uint32_t getIngestQueueSize(void) const = 0;
+
+        // where the messages of each level go, a combination of LogSink flags (optional; defaults to the console and the file)
+        virtual uint32_t getLogSinks(LogLevel level) const = 0;
+
+        // log nothing at all (optional; defaults to false)
+        virtual bool getLogQuiet(void) const = 0;
+
+        // which report files to write (optional; defaults to the CSV only)
+        virtual uint32_t getReportFormat(void) const = 0;
+
+        // how many seconds of wall clock time the report may be held in memory before it is written (optional;
+        // defaults to one second; zero writes only full buffers)
+        virtual uint32_t getReportFlushInterval(void) const = 0;
+
+        // the cohorts of wallets that generate transactions; at least one
+        virtual uint32_t getPopulationCount(void) const = 0;
+        virtual const PopulationDesc &getPopulation(uint32_t index) const = 0;
+
         virtual void release(void) = 0;
     protected:
         virtual ~SimulationSettings(void)
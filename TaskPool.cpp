@@ -0,0 +1,183 @@
+#include "TaskPool.h"
+#include "NsUserAllocated.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+
+namespace blockchainsim
+{
+
+    typedef std::deque< Task * > TaskDeque;
+
+    class WorkerQueue : public UserAllocated
+    {
+    public:
+        std::mutex  mLock;
+        TaskDeque   mTasks;
+    };
+
+    class TaskPoolImpl : public TaskPool, public UserAllocated
+    {
+    public:
+        TaskPoolImpl(uint32_t threadCount)
+        {
+            if (threadCount == 0)
+            {
+                threadCount = std::thread::hardware_concurrency();
+                if (threadCount == 0)
+                {
+                    threadCount = 1;
+                }
+            }
+            mShutdown = false;
+            mPending = 0;
+            mNextQueue = 0;
+            mQueues.resize(threadCount);
+            for (uint32_t i = 0; i < threadCount; i++)
+            {
+                mQueues[i] = NV_NEW(WorkerQueue);
+            }
+            for (uint32_t i = 0; i < threadCount; i++)
+            {
+                mThreads.push_back(std::thread(&TaskPoolImpl::workerThread, this, i));
+            }
+        }
+
+        virtual ~TaskPoolImpl(void)
+        {
+            {
+                std::lock_guard< std::mutex > lock(mSignalLock);
+                mShutdown = true;
+            }
+            mWorkAvailable.notify_all();
+            for (auto &t : mThreads)
+            {
+                t.join();
+            }
+            for (auto &q : mQueues)
+            {
+                delete q;
+            }
+        }
+
+        virtual void submit(Task *t) final
+        {
+            mPending++;
+            // Spread submissions round-robin; workers that run dry will steal the rest
+            uint32_t index = mNextQueue++ % uint32_t(mQueues.size());
+            {
+                std::lock_guard< std::mutex > lock(mQueues[index]->mLock);
+                mQueues[index]->mTasks.push_back(t);
+            }
+            {
+                std::lock_guard< std::mutex > lock(mSignalLock);
+            }
+            mWorkAvailable.notify_one();
+        }
+
+        virtual void wait(void) final
+        {
+            std::unique_lock< std::mutex > lock(mSignalLock);
+            mWorkComplete.wait(lock, [this] { return mPending == 0; });
+        }
+
+        virtual uint32_t getThreadCount(void) const final
+        {
+            return uint32_t(mThreads.size());
+        }
+
+        virtual void release(void) final
+        {
+            delete this;
+        }
+
+    private:
+        // Pop from the back of our own queue first, then steal from the front of the others
+        Task *findTask(uint32_t self)
+        {
+            Task *ret = nullptr;
+            uint32_t count = uint32_t(mQueues.size());
+            for (uint32_t i = 0; i < count && !ret; i++)
+            {
+                uint32_t index = (self + i) % count;
+                WorkerQueue *q = mQueues[index];
+                std::lock_guard< std::mutex > lock(q->mLock);
+                if (!q->mTasks.empty())
+                {
+                    if (index == self)
+                    {
+                        ret = q->mTasks.back();
+                        q->mTasks.pop_back();
+                    }
+                    else
+                    {
+                        ret = q->mTasks.front();
+                        q->mTasks.pop_front();
+                    }
+                }
+            }
+            return ret;
+        }
+
+        void workerThread(uint32_t self)
+        {
+            for (;;)
+            {
+                Task *t = findTask(self);
+                if (t)
+                {
+                    t->execute();
+                    if (--mPending == 0)
+                    {
+                        std::lock_guard< std::mutex > lock(mSignalLock);
+                        mWorkComplete.notify_all();
+                    }
+                    continue;
+                }
+                std::unique_lock< std::mutex > lock(mSignalLock);
+                if (mShutdown)
+                {
+                    break;
+                }
+                // Re-check under the signal lock so a submit between the scan and the wait is not missed
+                mWorkAvailable.wait(lock, [this] { return mShutdown || hasWork(); });
+                if (mShutdown && !hasWork())
+                {
+                    break;
+                }
+            }
+        }
+
+        bool hasWork(void)
+        {
+            for (auto &q : mQueues)
+            {
+                std::lock_guard< std::mutex > lock(q->mLock);
+                if (!q->mTasks.empty())
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool                        mShutdown;
+        std::atomic< uint32_t >     mPending;
+        std::atomic< uint32_t >     mNextQueue;
+        std::mutex                  mSignalLock;
+        std::condition_variable     mWorkAvailable;
+        std::condition_variable     mWorkComplete;
+        std::vector< WorkerQueue * > mQueues;
+        std::vector< std::thread >  mThreads;
+    };
+
+    TaskPool *TaskPool::create(uint32_t threadCount)
+    {
+        TaskPoolImpl *t = NV_NEW(TaskPoolImpl)(threadCount);
+        return static_cast<TaskPool *>(t);
+    }
+
+} // end of blockchainsim namespace
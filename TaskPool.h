@@ -0,0 +1,45 @@
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <stdint.h>
+
+// A small work-stealing thread pool.  Each worker owns a queue of tasks; an idle worker
+// pops from the back of its own queue and steals from the front of other workers' queues.
+
+namespace blockchainsim
+{
+
+    class Task
+    {
+    public:
+        virtual void execute(void) = 0;
+    protected:
+        virtual ~Task(void)
+        {
+        }
+    };
+
+    class TaskPool
+    {
+    public:
+        // Create a pool with this many worker threads; zero means one per hardware thread
+        static TaskPool *create(uint32_t threadCount);
+
+        // Queue a task; the caller retains ownership and must keep it alive until 'wait' returns
+        virtual void submit(Task *t) = 0;
+
+        // Block until every submitted task has completed
+        virtual void wait(void) = 0;
+
+        virtual uint32_t getThreadCount(void) const = 0;
+
+        virtual void release(void) = 0;
+    protected:
+        virtual ~TaskPool(void)
+        {
+        }
+    };
+
+} // end of blockchainsim namespace
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+// A hierarchical timing wheel keyed on 32 bit second time stamps.  Four levels of 256 slots
+// cover the whole 32 bit range with no overflow list.  An entry is placed on the lowest level
+// whose slot block it shares with the current time, and is cascaded down a level each time the
+// wheel crosses into its block.  Empty stretches are skipped a whole slot block at a time, so
+// advancing the clock costs time proportional to the number of entries that fire, not to the
+// number scheduled or the length of time covered.
+
+#include <stdint.h>
+#include <vector>
+
+namespace blockchainsim
+{
+
+    #define WHEEL_LEVELS 4
+    #define WHEEL_SLOT_BITS 8
+    #define WHEEL_SLOTS (1<<WHEEL_SLOT_BITS)
+    #define WHEEL_SLOT_MASK (WHEEL_SLOTS-1)
+
+    template< class T > class TimingWheel
+    {
+    public:
+        TimingWheel(void)
+        {
+            mCurrent = 0;
+            mCount = 0;
+            mDueCount = 0;
+            for (uint32_t i = 0; i < WHEEL_LEVELS; i++)
+            {
+                mLevelCount[i] = 0;
+            }
+        }
+
+        // schedule 'payload' to fire once the clock reaches 'expireTime'
+        void insert(uint32_t expireTime, const T &payload)
+        {
+            Entry e;
+            e.mTime = expireTime;
+            e.mPayload = payload;
+            place(e);
+            mCount++;
+        }
+
+        // Advance the clock to 'now', calling 'fire(payload)' for every entry that expires on the way
+        template< class F > void advance(uint32_t now, F &fire)
+        {
+            fireSlot(mDue, fire, mDueCount);
+            while (mCurrent < now)
+            {
+                if (mCount == 0)
+                {
+                    mCurrent = now;     // nothing scheduled; jump straight there
+                    break;
+                }
+                uint32_t next = mCurrent + 1;
+                if (mLevelCount[0] == 0)
+                {
+                    // Nothing can fire before the next slot boundary of the lowest occupied level
+                    uint32_t level = 1;
+                    while (mLevelCount[level] == 0)
+                    {
+                        level++;
+                    }
+                    uint32_t mask = (uint32_t(1) << (level * WHEEL_SLOT_BITS)) - 1;
+                    if ((mCurrent | mask) >= now)
+                    {
+                        mCurrent = now;
+                        break;
+                    }
+                    next = (mCurrent | mask) + 1;
+                }
+                mCurrent = next;
+                // Crossing into a new block of a higher level pulls its entries down a level
+                if ((mCurrent & WHEEL_SLOT_MASK) == 0)
+                {
+                    for (uint32_t level = WHEEL_LEVELS - 1; level != 0; level--)
+                    {
+                        uint32_t shift = level * WHEEL_SLOT_BITS;
+                        if ((mCurrent & ((uint32_t(1) << shift) - 1)) == 0)
+                        {
+                            cascade(level, (mCurrent >> shift) & WHEEL_SLOT_MASK);
+                        }
+                    }
+                    fireSlot(mDue, fire, mDueCount);    // cascaded entries that expire this very second
+                }
+                fireSlot(mSlots[0][mCurrent & WHEEL_SLOT_MASK], fire, mLevelCount[0]);
+            }
+        }
+
+        // number of entries still scheduled
+        uint32_t getCount(void) const
+        {
+            return mCount;
+        }
+
+    private:
+        class Entry
+        {
+        public:
+            uint32_t    mTime;
+            T           mPayload;
+        };
+
+        typedef std::vector< Entry > EntryVector;
+
+        void place(const Entry &e)
+        {
+            if (e.mTime <= mCurrent)
+            {
+                mDue.push_back(e);
+                mDueCount++;
+                return;
+            }
+            for (uint32_t level = 0; level < WHEEL_LEVELS; level++)
+            {
+                uint32_t shift = (level + 1) * WHEEL_SLOT_BITS;
+                // same block of this level as the current time (or the top level)
+                if (level == WHEEL_LEVELS - 1 || (e.mTime >> shift) == (mCurrent >> shift))
+                {
+                    uint32_t slot = (e.mTime >> (level * WHEEL_SLOT_BITS)) & WHEEL_SLOT_MASK;
+                    mSlots[level][slot].push_back(e);
+                    mLevelCount[level]++;
+                    return;
+                }
+            }
+        }
+
+        void cascade(uint32_t level, uint32_t slot)
+        {
+            EntryVector entries;
+            entries.swap(mSlots[level][slot]);
+            mLevelCount[level] -= uint32_t(entries.size());
+            for (auto &e : entries)
+            {
+                place(e);
+            }
+        }
+
+        template< class F > void fireSlot(EntryVector &slot, F &fire, uint32_t &levelCount)
+        {
+            if (!slot.empty())
+            {
+                EntryVector entries;
+                entries.swap(slot);
+                mCount -= uint32_t(entries.size());
+                levelCount -= uint32_t(entries.size());
+                for (auto &e : entries)
+                {
+                    fire(e.mPayload);
+                }
+            }
+        }
+
+        uint32_t        mCurrent;                               // the wheel's clock
+        uint32_t        mCount;                                 // entries scheduled
+        uint32_t        mDueCount;
+        uint32_t        mLevelCount[WHEEL_LEVELS];              // entries scheduled on each level
+        EntryVector     mDue;                                   // inserted at or before the current time
+        EntryVector     mSlots[WHEEL_LEVELS][WHEEL_SLOTS];
+    };
+
+} // end of blockchainsim namespace
+
+#endif
@@ -0,0 +1,181 @@
+#include "Population.h"
+#include "Transaction.h"
+#include "MappedFile.h"
+#include "NsUserAllocated.h"
+#include "logging.h"
+#include <string.h>
+
+#pragma warning(disable:4100)
+
+// Replays a recorded stream of transactions instead of generating them.  The trace is mapped
+// rather than loaded, so a multi-year trace of hundreds of millions of transactions is streamed
+// through a small window: the pages ahead of the read position are requested before they are
+// needed and the pages behind it are handed back.
+//
+// A trace file is little-endian and tightly packed:
+//
+//  header:     uint32  magic ('BCTR')
+//              uint32  version (1)
+//              uint64  record count
+//  records:    uint32  time stamp (seconds since 1970, in non-decreasing order)
+//              uint32  size in bytes (virtual bytes for a segwit trace)
+//              uint32  fee in satoshis
+//              int64   value in satoshis
+//
+// Time stamps are shifted so the first record falls on the second the simulation starts.
+
+namespace blockchainsim
+{
+
+#define TRACE_MAGIC 0x52544342          // 'BCTR'
+#define TRACE_VERSION 1
+#define TRACE_HEADER_SIZE 16
+#define TRACE_RECORD_SIZE 20
+#define TRACE_READ_AHEAD (8*1024*1024)  // bytes requested ahead of the read position at a time
+#define TRACE_BATCH 1024                // transactions handed to the sink per call
+
+class TraceReplayPopulationImpl : public Population, public UserAllocated
+{
+public:
+    TraceReplayPopulationImpl(MappedFile *file, uint64_t recordCount, uint32_t startTime, uint32_t index, uint32_t count)
+    {
+        mFile = file;
+        mData = file->getData() + TRACE_HEADER_SIZE;
+        mRecord = 0;
+        mRecordCount = recordCount;
+        mOffset = mRecordCount ? int64_t(startTime) - int64_t(read32(0, 0)) : 0;
+        mNextID = index + 1;
+        mIDStride = count;
+        mReadAhead = 0;
+        mReleased = 0;
+        readAhead();
+    }
+
+    virtual ~TraceReplayPopulationImpl(void)
+    {
+        mFile->release();
+    }
+
+    // every record due by 'timeStamp' goes to the sink, including any recorded out of order
+    virtual bool pump(uint32_t timeStamp, TransactionSink *sink)
+    {
+        uint32_t count = 0;
+        while (mRecord < mRecordCount && getTime(mRecord) <= timeStamp)
+        {
+            Transaction &t = mBatch[count];
+            t.mTimestamp        = timeStamp;
+            uint32_t size       = read32(mRecord, 4);
+            t.mTransactionSize  = size < TF_SIZE_MASK ? size : TF_SIZE_MASK;
+            t.mFee              = read32(mRecord, 8);
+            memcpy(&t.mValue, mData + mRecord * TRACE_RECORD_SIZE + 12, sizeof(t.mValue));
+            t.mID               = mNextID;
+            mNextID            += mIDStride;
+            mRecord++;
+            if (++count == TRACE_BATCH)
+            {
+                sink->addTransactions(mBatch, count, nullptr);
+                count = 0;
+            }
+        }
+        if (count)
+        {
+            sink->addTransactions(mBatch, count, nullptr);
+        }
+        readAhead();
+        return true;
+    }
+
+    virtual uint32_t getNextActiveTime(uint32_t timeStamp) const
+    {
+        if (mRecord >= mRecordCount)
+        {
+            return 0xFFFFFFFF;
+        }
+        uint32_t t = getTime(mRecord);
+        return t > timeStamp ? t : timeStamp;
+    }
+
+    virtual void release(void)
+    {
+        delete this;
+    }
+
+private:
+    uint32_t read32(uint64_t record, uint32_t offset) const
+    {
+        uint32_t ret;
+        memcpy(&ret, mData + record * TRACE_RECORD_SIZE + offset, sizeof(ret));
+        return ret;
+    }
+
+    // the simulation second a record falls on
+    uint32_t getTime(uint64_t record) const
+    {
+        int64_t t = int64_t(read32(record, 0)) + mOffset;
+        return t < 0 ? 0 : t > 0xFFFFFFFE ? 0xFFFFFFFE : uint32_t(t);
+    }
+
+    // Keep a window requested ahead of the read position and give back whole windows behind it
+    void readAhead(void)
+    {
+        uint64_t position = TRACE_HEADER_SIZE + mRecord * TRACE_RECORD_SIZE;
+        if (position + TRACE_READ_AHEAD > mReadAhead)
+        {
+            mFile->willNeed(mReadAhead, TRACE_READ_AHEAD);
+            mReadAhead += TRACE_READ_AHEAD;
+        }
+        uint64_t done = position - position % TRACE_READ_AHEAD;
+        if (done > mReleased)
+        {
+            mFile->dontNeed(mReleased, done - mReleased);
+            mReleased = done;
+        }
+    }
+
+    MappedFile          *mFile;
+    const uint8_t       *mData;                     // the first record
+    uint64_t            mRecord;                    // the next record to replay
+    uint64_t            mRecordCount;
+    int64_t             mOffset;                    // added to a recorded time stamp to give the simulation time
+    uint32_t            mNextID;
+    uint32_t            mIDStride;                  // how many cohorts share the ID space
+    uint64_t            mReadAhead;                 // file offset requested up to
+    uint64_t            mReleased;                  // file offset given back up to
+    Transaction         mBatch[TRACE_BATCH];
+};
+
+Population *createTraceReplayPopulation(const char *fname, uint32_t startTime, uint32_t index, uint32_t count)
+{
+    MappedFile *file = MappedFile::create(fname);
+    if (!file)
+    {
+        logMessage(LL_ERROR, "ERROR: Unable to open the transaction trace '%s'\n", fname);
+        return nullptr;
+    }
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint64_t recordCount = 0;
+    if (file->getSize() >= TRACE_HEADER_SIZE)
+    {
+        memcpy(&magic, file->getData(), sizeof(magic));
+        memcpy(&version, file->getData() + 4, sizeof(version));
+        memcpy(&recordCount, file->getData() + 8, sizeof(recordCount));
+    }
+    if (magic != TRACE_MAGIC || version != TRACE_VERSION)
+    {
+        logMessage(LL_ERROR, "ERROR: '%s' is not a version %d transaction trace\n", fname, TRACE_VERSION);
+        file->release();
+        return nullptr;
+    }
+    // a trace cut short by a failed copy replays what it holds
+    uint64_t available = (file->getSize() - TRACE_HEADER_SIZE) / TRACE_RECORD_SIZE;
+    if (recordCount > available)
+    {
+        logMessage(LL_WARNING, "WARNING: '%s' holds %llu of its %llu transactions\n", fname, (unsigned long long)available, (unsigned long long)recordCount);
+        recordCount = available;
+    }
+    TraceReplayPopulationImpl *p = NV_NEW(TraceReplayPopulationImpl)(file, recordCount, startTime, index, count);
+    return static_cast<Population *>(p);
+}
+
+} // end of blockchainsim namespace
@@ -6,6 +6,15 @@
 namespace blockchainsim
 {
 
+    #define SATOSHIS_PER_BITCOIN 100000000LL
+
+    // TF_ flags ride in the top byte of mTransactionSize, which no real transaction comes near
+    #define TF_SIZE_MASK   0x00FFFFFF
+    #define TF_REPLACEMENT 0x80000000   // replaces the pending transaction with the same ID, paying a higher fee (replace-by-fee)
+
+    // Amounts are integer satoshis so that mempool and block totals are exact.  The fee is 32 bits
+    // (up to ~42.9 bitcoin), which packs the record into 24 bytes.  A child's parent travels beside
+    // the batch rather than in the record, as most transactions have none.
     class Transaction
     {
     public:
@@ -18,6 +27,16 @@ namespace blockchainsim
             mTransactionSize = 0;
         }
 
+        uint32_t getFlags(void) const
+        {
+            return mTransactionSize & ~TF_SIZE_MASK;
+        }
+
+        void clearFlags(void)
+        {
+            mTransactionSize &= TF_SIZE_MASK;
+        }
+
         bool operator<(const Transaction &a) const
         {
             if (a.mFee != mFee )
@@ -32,11 +51,27 @@ namespace blockchainsim
             return a.mFee == mFee && a.mID == mID;
         }
 
+        int64_t		mValue;		// The value of this transaction in satoshis.
+        uint32_t	mFee;		// the fee of the transaction in satoshis
         uint32_t	mID;		// transaction ID
-        double		mValue;		// The value of this transaction.
-        double		mFee;		// the fee of the transaction
         uint32_t	mTimestamp; // the timestamp that the transaction was issued.
-        uint32_t	mTransactionSize;	// The size of this transaction in bytes.
+        uint32_t	mTransactionSize;	// The size of this transaction in bytes, with TF_ bits above TF_SIZE_MASK.
+    };
+
+    static_assert(sizeof(Transaction) <= 24, "Transaction should pack into 24 bytes");
+
+    // Where a population delivers the transactions it generates; the mempool itself, or a queue
+    // that carries them to the mempool from another thread
+    class TransactionSink
+    {
+    public:
+        // Add a contiguous batch of transactions in one call.  'parentIDs' holds, for each, the ID of the
+        // transaction whose output it spends, or zero if it spends confirmed coins; null if none has a parent.
+        virtual void addTransactions(const Transaction *t, uint32_t count, const uint32_t *parentIDs) = 0;
+    protected:
+        virtual ~TransactionSink(void)
+        {
+        }
     };
 
 }
@@ -0,0 +1,242 @@
+#include "TransactionIngest.h"
+#include "Transaction.h"
+#include "Population.h"
+#include "MpscRing.h"
+#include "NsUserAllocated.h"
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+namespace blockchainsim
+{
+
+    // a queued transaction, the parent it spends from and the producer that generated it
+    class IngestEntry
+    {
+    public:
+        Transaction mTransaction;
+        uint32_t    mParentID;
+        uint32_t    mProducer;
+    };
+
+    typedef std::vector< IngestEntry > IngestEntryVector;
+    typedef std::vector< Transaction > TransactionVector;
+    typedef std::vector< uint32_t > UIntVector;
+    typedef MpscRing< IngestEntry > IngestRing;
+
+    #define INGEST_SPIN_YIELDS 64
+
+    // Waiting on the other side of the queue; yield a while, then sleep so a spinning thread does not
+    // steal the core from the one it is waiting for
+    static void backoff(uint32_t &spins)
+    {
+        if (spins < INGEST_SPIN_YIELDS)
+        {
+            spins++;
+            std::this_thread::yield();
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    // Same second first, then producer order; within a producer the queue already preserves generation order
+    static bool isEarlier(const IngestEntry &a, const IngestEntry &b)
+    {
+        if (a.mTransaction.mTimestamp != b.mTransaction.mTimestamp)
+        {
+            return a.mTransaction.mTimestamp < b.mTransaction.mTimestamp;
+        }
+        return a.mProducer < b.mProducer;
+    }
+
+    class IngestProducer : public TransactionSink, public UserAllocated
+    {
+    public:
+        IngestProducer(IngestRing &ring, std::atomic< bool > &stop, std::atomic< uint32_t > &horizon, uint32_t lookahead, Population *p, uint32_t index) : mRing(ring), mStop(stop), mHorizon(horizon)
+        {
+            mLookahead = lookahead;
+            mPopulation = p;
+            mIndex = index;
+            mCompleted.store(0, std::memory_order_relaxed);
+        }
+
+        // the population delivers here, on the producer thread; waits for room while the queue is full
+        virtual void addTransactions(const Transaction *t, uint32_t count, const uint32_t *parentIDs) final
+        {
+            IngestEntry e;
+            e.mProducer = mIndex;
+            for (uint32_t i = 0; i < count; i++)
+            {
+                e.mTransaction = t[i];
+                e.mParentID = parentIDs ? parentIDs[i] : 0;
+                uint32_t spins = 0;
+                while (!mRing.push(e))
+                {
+                    if (mStop.load(std::memory_order_relaxed))
+                    {
+                        return;
+                    }
+                    backoff(spins);
+                }
+            }
+        }
+
+        void run(uint32_t startTime)
+        {
+            uint32_t t = mPopulation->getNextActiveTime(startTime);
+            while (!mStop.load(std::memory_order_relaxed))
+            {
+                // Every second before 't' is idle, so it is complete before anything is generated for 't'
+                mCompleted.store(t - 1, std::memory_order_release);
+                uint32_t spins = 0;
+                while (t > mHorizon.load(std::memory_order_acquire) + mLookahead)
+                {
+                    if (mStop.load(std::memory_order_relaxed))
+                    {
+                        return;
+                    }
+                    backoff(spins);
+                }
+                mPopulation->pump(t, this);
+                mCompleted.store(t, std::memory_order_release);
+                t = mPopulation->getNextActiveTime(t + 1);
+            }
+        }
+
+        IngestRing              &mRing;
+        std::atomic< bool >     &mStop;
+        std::atomic< uint32_t > &mHorizon;
+        uint32_t                mLookahead;
+        Population              *mPopulation;
+        uint32_t                mIndex;
+        std::atomic< uint32_t > mCompleted;     // the last second whose transactions are all queued
+        std::thread             mThread;
+    };
+
+    typedef std::vector< IngestProducer * > IngestProducerVector;
+
+    class TransactionIngestImpl : public TransactionIngest, public UserAllocated
+    {
+    public:
+        TransactionIngestImpl(uint32_t capacity, uint32_t lookahead) : mRing(capacity)
+        {
+            mLookahead = lookahead;
+            mStop.store(false);
+            mHorizon.store(0);
+        }
+
+        virtual ~TransactionIngestImpl(void)
+        {
+            mStop.store(true);
+            for (auto &p : mProducers)
+            {
+                p->mThread.join();
+                delete p;
+            }
+        }
+
+        virtual void addProducer(Population *p, uint32_t startTime) final
+        {
+            if (startTime > mHorizon.load())
+            {
+                mHorizon.store(startTime);
+            }
+            IngestProducer *producer = NV_NEW(IngestProducer)(mRing, mStop, mHorizon, mLookahead, p, uint32_t(mProducers.size()));
+            mProducers.push_back(producer);
+            producer->mThread = std::thread(&IngestProducer::run, producer, startTime);
+        }
+
+        virtual uint32_t drain(uint32_t timeStamp, TransactionSink *sink) final
+        {
+            mHorizon.store(timeStamp, std::memory_order_release);     // lets the producers run on while this one waits
+            // Entries popped by an earlier drain that were not yet due go first; they were queued before anything still in the ring
+            mDue.clear();
+            uint32_t held = 0;
+            for (auto &e : mHeld)
+            {
+                if (e.mTransaction.mTimestamp <= timeStamp)
+                {
+                    mDue.push_back(e);
+                }
+                else
+                {
+                    mHeld[held++] = e;
+                }
+            }
+            mHeld.resize(held);
+            uint32_t spins = 0;
+            for (;;)
+            {
+                // Read the producers' progress before emptying the ring, so everything they queued up to it is seen
+                bool caughtUp = true;
+                for (auto &p : mProducers)
+                {
+                    if (p->mCompleted.load(std::memory_order_acquire) < timeStamp)
+                    {
+                        caughtUp = false;
+                    }
+                }
+                // Entries from producers that are ahead can sit in front of due ones from a producer that is not
+                IngestEntry e;
+                while (mRing.pop(e))
+                {
+                    if (e.mTransaction.mTimestamp <= timeStamp)
+                    {
+                        mDue.push_back(e);
+                    }
+                    else
+                    {
+                        mHeld.push_back(e);
+                    }
+                }
+                if (caughtUp)
+                {
+                    break;
+                }
+                backoff(spins);
+            }
+            uint32_t count = uint32_t(mDue.size());
+            if (count)
+            {
+                // A stable order that does not depend on how the producer threads interleaved
+                std::stable_sort(mDue.begin(), mDue.end(), isEarlier);
+                mBatch.resize(count);
+                mParents.resize(count);
+                for (uint32_t i = 0; i < count; i++)
+                {
+                    mBatch[i] = mDue[i].mTransaction;
+                    mParents[i] = mDue[i].mParentID;
+                }
+                sink->addTransactions(&mBatch[0], count, &mParents[0]);
+            }
+            return count;
+        }
+
+        virtual void release(void) final
+        {
+            delete this;
+        }
+
+    private:
+        IngestRing              mRing;
+        uint32_t                mLookahead;
+        std::atomic< bool >     mStop;
+        std::atomic< uint32_t > mHorizon;       // the simulation time of the latest drain
+        IngestProducerVector    mProducers;
+        IngestEntryVector       mDue;           // scratch for the entries delivered by a drain
+        IngestEntryVector       mHeld;          // popped ahead of the simulation clock; bounded by the lookahead
+        TransactionVector       mBatch;
+        UIntVector              mParents;       // parent IDs beside mBatch
+    };
+
+    TransactionIngest *TransactionIngest::create(uint32_t capacity, uint32_t lookahead)
+    {
+        TransactionIngestImpl *t = NV_NEW(TransactionIngestImpl)(capacity, lookahead);
+        return static_cast<TransactionIngest *>(t);
+    }
+
+} // end of blockchainsim namespace
@@ -0,0 +1,43 @@
+#ifndef TRANSACTION_INGEST_H
+#define TRANSACTION_INGEST_H
+
+#include <stdint.h>
+
+// Runs populations on their own producer threads, ahead of the simulation clock, and carries the
+// transactions they generate to the mempool's thread through a bounded lock-free queue.  The
+// mempool owner drains everything stamped up to the current simulation time in one batch, in
+// time order, so the mempool sees exactly the sequence it would have seen had the populations
+// been pumped inline.
+
+namespace blockchainsim
+{
+
+    class Population;
+    class TransactionSink;
+
+    class TransactionIngest
+    {
+    public:
+        // 'capacity' is the number of transactions the queue holds before producers must wait; 'lookahead' is
+        // how many seconds past the latest drain the producers may generate
+        static TransactionIngest *create(uint32_t capacity, uint32_t lookahead);
+
+        // Start a thread that pumps 'p' for every active second from 'startTime' on.  The caller keeps
+        // ownership of the population and must not touch it, or release it, until the ingest is released.
+        virtual void addProducer(Population *p, uint32_t startTime) = 0;
+
+        // Hand every transaction stamped at or before 'timeStamp' to 'sink', waiting for the producers
+        // to get that far first.  Returns the number of transactions delivered.
+        virtual uint32_t drain(uint32_t timeStamp, TransactionSink *sink) = 0;
+
+        // stops and joins the producer threads; anything still queued is discarded
+        virtual void release(void) = 0;
+    protected:
+        virtual ~TransactionIngest(void)
+        {
+        }
+    };
+
+} // end of blockchainsim namespace
+
+#endif
@@ -0,0 +1,428 @@
+#ifndef TRANSACTION_STORE_H
+#define TRANSACTION_STORE_H
+
+// Pending transactions kept as a structure of arrays.  Each field lives in its own densely packed
+// array with no holes (a removal moves the last transaction into the gap), so statistics over the
+// whole mempool are straight linear passes over just the fields they need.  Transactions are
+// addressed by a handle that stays valid until it is removed, through one level of indirection
+// to the dense slot, and can be looked up by transaction ID through a hash index.  Each handle
+// also carries a 'Link' record the mempool policy uses to tie the transaction into its own
+// ordering structure.
+
+#include <stdint.h>
+#include <vector>
+#include "Transaction.h"
+#include "FeeRate.h"
+#include "MemPool.h"
+#include "NvAssert.h"
+
+namespace blockchainsim
+{
+
+    #define STORE_INVALID_SLOT 0xFFFFFFFF
+    #define SNAPSHOT_CHUNK 256
+
+    // Accumulates a MemPoolSnapshot one transaction at a time.  Percentiles are read from log scale
+    // histograms (four buckets per power of two, see FeeRate.h) and interpolated within the bucket.
+    class SnapshotBuilder
+    {
+    public:
+        SnapshotBuilder(uint32_t timeStamp, float cutoffFeeRate) : mTimeStamp(timeStamp), mCutoffFeeRate(cutoffFeeRate)
+        {
+            mCount = 0;
+            mBytes = 0;
+            mBytesAboveCutoff = 0;
+            mOldestAge = 0;
+            for (uint32_t i = 0; i < FEE_RATE_BUCKETS; i++)
+            {
+                mFeeRates[i] = 0;
+                mAges[i] = 0;
+            }
+        }
+
+        // Buckets a chunk at a time in a tight loop over the arrays, then scatters the histogram counts
+        void addBatch(const uint32_t *fees, const uint32_t *sizes, const uint32_t *timeStamps, uint32_t count)
+        {
+            uint8_t feeRateBuckets[SNAPSHOT_CHUNK];
+            uint8_t ageBuckets[SNAPSHOT_CHUNK];
+            for (uint32_t base = 0; base < count; base += SNAPSHOT_CHUNK)
+            {
+                uint32_t n = count - base < SNAPSHOT_CHUNK ? count - base : SNAPSHOT_CHUNK;
+                const uint32_t *f = fees + base;
+                const uint32_t *s = sizes + base;
+                const uint32_t *t = timeStamps + base;
+                // One chunk of sizes cannot overflow 32 bits (transactions are far below 16mb)
+                uint32_t bytes = 0;
+                uint32_t bytesAboveCutoff = 0;
+                int32_t oldestAge = int32_t(mOldestAge);
+                for (uint32_t i = 0; i < n; i++)
+                {
+                    // Written without branches and in 32 bit lanes so it vectorizes.  Sizes and ages stay
+                    // well below 2^31 and take signed conversions; a fee can use all 32 bits (bumped fees
+                    // saturate at 0xFFFFFFFF and traces carry real ones), so it is converted unsigned.
+                    int32_t size = int32_t(s[i]);
+                    size = size > 1 ? size : 1;
+                    float feeRate = float(f[i]) / float(size);
+                    int32_t age = int32_t(mTimeStamp - t[i]);
+                    age = age > 0 ? age : 0;
+                    feeRateBuckets[i] = uint8_t(getFeeRateBucket(feeRate));
+                    ageBuckets[i] = uint8_t(getFeeRateBucket(float(age)));
+                    bytes += s[i];
+                    bytesAboveCutoff += feeRate >= mCutoffFeeRate ? s[i] : 0;
+                    oldestAge = age > oldestAge ? age : oldestAge;
+                }
+                for (uint32_t i = 0; i < n; i++)
+                {
+                    mFeeRates[feeRateBuckets[i]]++;
+                    mAges[ageBuckets[i]]++;
+                }
+                mCount += n;
+                mBytes += bytes;
+                mBytesAboveCutoff += bytesAboveCutoff;
+                mOldestAge = uint32_t(oldestAge);
+            }
+        }
+
+        void add(uint32_t fee, uint32_t size, uint32_t timeStamp)
+        {
+            float feeRate = getFeeRate(fee, size);
+            uint32_t age = mTimeStamp > timeStamp ? mTimeStamp - timeStamp : 0;
+            mCount++;
+            mBytes += size;
+            mBytesAboveCutoff += feeRate >= mCutoffFeeRate ? size : 0;
+            mOldestAge = age > mOldestAge ? age : mOldestAge;
+            mFeeRates[getFeeRateBucket(feeRate)]++;
+            mAges[getFeeRateBucket(float(age))]++;     // same log scale, in seconds
+        }
+
+        void finish(MemPoolSnapshot &s) const
+        {
+            s.mCount = mCount;
+            s.mBytes = mBytes;
+            s.mBytesAboveCutoff = mBytesAboveCutoff;
+            s.mFeeRateP10 = getPercentile(mFeeRates, 0.1f);
+            s.mFeeRateP50 = getPercentile(mFeeRates, 0.5f);
+            s.mFeeRateP90 = getPercentile(mFeeRates, 0.9f);
+            s.mMedianAge = uint32_t(getPercentile(mAges, 0.5f));
+            s.mOldestAge = mOldestAge;
+        }
+
+    private:
+        float getPercentile(const uint32_t *counts, float p) const
+        {
+            float ret = 0;
+            if (mCount)
+            {
+                float target = p * float(mCount);
+                uint32_t sum = 0;
+                for (uint32_t b = 0; b < FEE_RATE_BUCKETS; b++)
+                {
+                    if (float(sum + counts[b]) >= target && counts[b])
+                    {
+                        float low = b ? getFeeRateBucketFloor(b) : 0.0f;
+                        float high = getFeeRateBucketFloor(b + 1);
+                        ret = low + (high - low) * ((target - float(sum)) / float(counts[b]));
+                        break;
+                    }
+                    sum += counts[b];
+                }
+            }
+            return ret;
+        }
+
+        uint32_t    mTimeStamp;
+        float       mCutoffFeeRate;
+        uint32_t    mCount;
+        uint64_t    mBytes;
+        uint64_t    mBytesAboveCutoff;
+        uint32_t    mOldestAge;
+        uint32_t    mFeeRates[FEE_RATE_BUCKETS];
+        uint32_t    mAges[FEE_RATE_BUCKETS];
+    };
+
+    // Transaction ID to handle, open addressed with linear probing.  IDs are never zero, so a zero key
+    // marks an empty cell.  A removal shifts the rest of its probe run back instead of leaving a
+    // tombstone, so lookups never slow down as transactions come and go.
+    class StoreIndex
+    {
+    public:
+        StoreIndex(void)
+        {
+            mCount = 0;
+            mShift = 32 - 10;
+            mCells.resize(size_t(1) << 10);
+        }
+
+        void insert(uint32_t id, uint32_t handle)
+        {
+            if ((mCount + 1) * 2 > mCells.size())
+            {
+                grow();
+            }
+            uint32_t mask = uint32_t(mCells.size() - 1);
+            uint32_t i = getHome(id);
+            while (mCells[i].mID)
+            {
+                i = (i + 1) & mask;
+            }
+            mCells[i].mID = id;
+            mCells[i].mHandle = handle;
+            mCount++;
+        }
+
+        // the handle stored for 'id', or STORE_INVALID_SLOT
+        uint32_t find(uint32_t id) const
+        {
+            uint32_t mask = uint32_t(mCells.size() - 1);
+            for (uint32_t i = getHome(id); mCells[i].mID; i = (i + 1) & mask)
+            {
+                if (mCells[i].mID == id)
+                {
+                    return mCells[i].mHandle;
+                }
+            }
+            return STORE_INVALID_SLOT;
+        }
+
+        void remove(uint32_t id)
+        {
+            uint32_t mask = uint32_t(mCells.size() - 1);
+            uint32_t i = getHome(id);
+            while (mCells[i].mID != id)
+            {
+                if (mCells[i].mID == 0)
+                {
+                    return;
+                }
+                i = (i + 1) & mask;
+            }
+            // Pull back any later entry of the run that may not sit between its home and the hole
+            for (uint32_t j = (i + 1) & mask; mCells[j].mID; j = (j + 1) & mask)
+            {
+                uint32_t home = getHome(mCells[j].mID);
+                if (((j - home) & mask) >= ((j - i) & mask))
+                {
+                    mCells[i] = mCells[j];
+                    i = j;
+                }
+            }
+            mCells[i].mID = 0;
+            mCount--;
+        }
+
+    private:
+        class Cell
+        {
+        public:
+            Cell(void) : mID(0), mHandle(0)
+            {
+            }
+            uint32_t    mID;
+            uint32_t    mHandle;
+        };
+
+        // Fibonacci hashing spreads consecutive IDs evenly
+        uint32_t getHome(uint32_t id) const
+        {
+            return (id * 2654435769u) >> mShift;
+        }
+
+        void grow(void)
+        {
+            std::vector< Cell > cells(mCells.size() * 2);
+            cells.swap(mCells);
+            mShift--;
+            mCount = 0;
+            for (auto &c : cells)
+            {
+                if (c.mID)
+                {
+                    insert(c.mID, c.mHandle);
+                }
+            }
+        }
+
+        uint32_t            mCount;
+        uint32_t            mShift;     // 32 less log2 of the table size
+        std::vector< Cell > mCells;
+    };
+
+    // for a policy whose ordering structure finds its transactions without help from the store
+    class StoreNoLink
+    {
+    };
+
+    template< class Link > class TransactionStore
+    {
+    public:
+        // returns the handle of the stored copy of 't'
+        uint32_t add(const Transaction &t)
+        {
+            uint32_t handle;
+            if (mFreeHandles.empty())
+            {
+                handle = uint32_t(mSlots.size());
+                mSlots.push_back(STORE_INVALID_SLOT);
+                mLinks.push_back(Link());
+            }
+            else
+            {
+                handle = mFreeHandles.back();
+                mFreeHandles.pop_back();
+            }
+            mSlots[handle] = uint32_t(mIDs.size());
+            mHandles.push_back(handle);
+            mIDs.push_back(t.mID);
+            mFees.push_back(t.mFee);
+            mSizes.push_back(t.mTransactionSize);
+            mTimestamps.push_back(t.mTimestamp);
+            mValues.push_back(t.mValue);
+            mIndex.insert(t.mID, handle);
+            return handle;
+        }
+
+        void remove(uint32_t handle)
+        {
+            uint32_t slot = mSlots[handle];
+            NV_ASSERT(slot != STORE_INVALID_SLOT);
+            uint32_t last = uint32_t(mIDs.size() - 1);
+            mIndex.remove(mIDs[slot]);
+            if (slot != last)
+            {
+                uint32_t moved = mHandles[last];
+                mHandles[slot] = moved;
+                mIDs[slot] = mIDs[last];
+                mFees[slot] = mFees[last];
+                mSizes[slot] = mSizes[last];
+                mTimestamps[slot] = mTimestamps[last];
+                mValues[slot] = mValues[last];
+                mSlots[moved] = slot;
+            }
+            mHandles.pop_back();
+            mIDs.pop_back();
+            mFees.pop_back();
+            mSizes.pop_back();
+            mTimestamps.pop_back();
+            mValues.pop_back();
+            mSlots[handle] = STORE_INVALID_SLOT;
+            mFreeHandles.push_back(handle);
+        }
+
+        // true if 'handle' is still stored and holds transaction 'id'; false once it was removed, even if reused
+        bool contains(uint32_t handle, uint32_t id) const
+        {
+            uint32_t slot = mSlots[handle];
+            return slot != STORE_INVALID_SLOT && mIDs[slot] == id;
+        }
+
+        // the handle of pending transaction 'id', or STORE_INVALID_SLOT if it is not stored
+        uint32_t find(uint32_t id) const
+        {
+            return mIndex.find(id);
+        }
+
+        // take the fee, size and value of 't' in place of those of 'handle'; the ID and timestamp are kept
+        void replace(uint32_t handle, const Transaction &t)
+        {
+            uint32_t slot = mSlots[handle];
+            mFees[slot] = t.mFee;
+            mSizes[slot] = t.mTransactionSize;
+            mValues[slot] = t.mValue;
+        }
+
+        void get(uint32_t handle, Transaction &t) const
+        {
+            uint32_t slot = mSlots[handle];
+            t.mID = mIDs[slot];
+            t.mFee = mFees[slot];
+            t.mTransactionSize = mSizes[slot];
+            t.mTimestamp = mTimestamps[slot];
+            t.mValue = mValues[slot];
+        }
+
+        uint32_t getID(uint32_t handle) const
+        {
+            return mIDs[mSlots[handle]];
+        }
+
+        uint32_t getFee(uint32_t handle) const
+        {
+            return mFees[mSlots[handle]];
+        }
+
+        uint32_t getSize(uint32_t handle) const
+        {
+            return mSizes[mSlots[handle]];
+        }
+
+        int64_t getValue(uint32_t handle) const
+        {
+            return mValues[mSlots[handle]];
+        }
+
+        Link &getLink(uint32_t handle)
+        {
+            return mLinks[handle];
+        }
+
+        const Link &getLink(uint32_t handle) const
+        {
+            return mLinks[handle];
+        }
+
+        uint32_t getCount(void) const
+        {
+            return uint32_t(mIDs.size());
+        }
+
+        void getFeeRateHistogram(FeeRateHistogram &h) const
+        {
+            h.clear();
+            addToFeeRateHistogram(h);
+        }
+
+        void addToFeeRateHistogram(FeeRateHistogram &h) const
+        {
+            uint32_t count = getCount();
+            for (uint32_t i = 0; i < count; i++)
+            {
+                uint32_t b = getFeeRateBucket(getFeeRate(mFees[i], mSizes[i]));
+                h.mCount[b]++;
+                h.mBytes[b] += mSizes[i];
+            }
+        }
+
+        // one pass over the fee, size and timestamp arrays
+        void getSnapshot(uint32_t timeStamp, float cutoffFeeRate, MemPoolSnapshot &s) const
+        {
+            SnapshotBuilder b(timeStamp, cutoffFeeRate);
+            addToSnapshot(b);
+            b.finish(s);
+        }
+
+        void addToSnapshot(SnapshotBuilder &b) const
+        {
+            if (!mIDs.empty())
+            {
+                b.addBatch(&mFees[0], &mSizes[0], &mTimestamps[0], getCount());
+            }
+        }
+
+    private:
+        StoreIndex              mIndex;         // transaction ID to handle
+        // indexed by handle
+        std::vector< uint32_t > mSlots;         // dense slot of each handle, or STORE_INVALID_SLOT
+        std::vector< Link >     mLinks;
+        std::vector< uint32_t > mFreeHandles;
+        // indexed by dense slot
+        std::vector< uint32_t > mHandles;
+        std::vector< uint32_t > mIDs;
+        std::vector< uint32_t > mFees;          // satoshis
+        std::vector< uint32_t > mSizes;         // bytes
+        std::vector< uint32_t > mTimestamps;
+        std::vector< int64_t >  mValues;        // satoshis
+    };
+
+} // end of blockchainsim namespace
+
+#endif
@@ -103,7 +103,7 @@ namespace blockchainsim
             while (*source)
             {
                 char c = *source;
-                if (isDigit(c) || c == '.' || c == '-' || c == '+' || c == '!' || c == ':' || c == '<' || c == '>')
+                if (isDigit(c) || c == '.' || c == '-' || c == '+' || c == '!' || c == '~' || c == ':' || c == '<' || c == '>')
                 {
                     *dest++ = c;
                     source++;
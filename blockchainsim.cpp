@@ -1,35 +1,146 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "SimulationSettings.h"
 #include "BlockChain.h"
+#include "MonteCarlo.h"
+#include "GaussBenchmark.h"
+#include "ColumnFile.h"
 
 using namespace blockchainsim;
 
+// any value of a column as a double
+static double getColumnValue(const void *data, ColumnType type, uint32_t row)
+{
+	switch (type)
+	{
+		case CT_UINT32: return double(static_cast<const uint32_t *>(data)[row]);
+		case CT_UINT64: return double(static_cast<const uint64_t *>(data)[row]);
+		case CT_INT64: return double(static_cast<const int64_t *>(data)[row]);
+		case CT_FLOAT: return double(static_cast<const float *>(data)[row]);
+		case CT_DOUBLE: return static_cast<const double *>(data)[row];
+	}
+	return 0;
+}
+
+// Print the schema of a column file and the range of every column
+static void printColumns(const char *fname)
+{
+	static const char *typeNames[] = { "uint32", "uint64", "int64", "float", "double" };
+	ColumnReader *r = ColumnReader::create(fname);
+	if (!r)
+	{
+		printf("Unable to read the column file '%s'\n", fname);
+		return;
+	}
+	printf("%s : %llu rows in %d chunks\n", fname, (unsigned long long)r->getRowCount(), r->getChunkCount());
+	for (uint32_t c = 0; c < r->getColumnCount(); c++)
+	{
+		ColumnType type = r->getColumnType(c);
+		double minValue = 0;
+		double maxValue = 0;
+		for (uint32_t chunk = 0; chunk < r->getChunkCount(); chunk++)
+		{
+			uint32_t count;
+			const void *data = r->getColumn(c, chunk, count);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				double v = getColumnValue(data, type, i);
+				bool first = chunk == 0 && i == 0;
+				minValue = (first || v < minValue) ? v : minValue;
+				maxValue = (first || v > maxValue) ? v : maxValue;
+			}
+		}
+		printf("%-28s %-8s %18.6f %18.6f\n", r->getColumnName(c), typeNames[type], minValue, maxValue);
+	}
+	r->release();
+}
+
 int main(int argc,const char **argv)
 {
 	if ( argc == 1 )
 	{
-		printf("Usage: blockchainsim <simulation_file.ini>\n");
+		printf("Usage: blockchainsim <simulation_file.ini> [--runs N] [--threads M] [--gauss-benchmark] [--quiet]\n");
+		printf("       blockchainsim --columns <BlockChain.bcol>\n");
+		printf("--runs N    : run N independent seeds and write confidence bands to MonteCarlo.csv\n");
+		printf("--threads M : number of worker threads for --runs (default one per core)\n");
+		printf("--gauss-benchmark : compare the polar and Ziggurat samplers on the INI's specs and exit\n");
+		printf("--quiet     : log nothing; the results are still written\n");
+		printf("--columns   : print the columns of a binary report and the range of each\n");
+	}
+	else if ( strcmp(argv[1], "--columns") == 0 )
+	{
+		if ( argc > 2 )
+		{
+			printColumns(argv[2]);
+		}
 	}
 	else
 	{
 		const char *simFile = argv[1];
+		uint32_t runCount = 0;
+		uint32_t threadCount = 0;
+		bool gaussBenchmark = false;
+		bool quiet = false;
+		for (int i = 2; i < argc; i++)
+		{
+			if ( strcmp(argv[i], "--runs") == 0 && (i + 1) < argc )
+			{
+				runCount = uint32_t(atoi(argv[++i]));
+			}
+			else if ( strcmp(argv[i], "--threads") == 0 && (i + 1) < argc )
+			{
+				threadCount = uint32_t(atoi(argv[++i]));
+			}
+			else if ( strcmp(argv[i], "--gauss-benchmark") == 0 )
+			{
+				gaussBenchmark = true;
+			}
+			else if ( strcmp(argv[i], "--quiet") == 0 )
+			{
+				quiet = true;
+			}
+			else
+			{
+				printf("Unknown option '%s'\n", argv[i]);
+			}
+		}
+        setLogQuiet(quiet);
         SimulationSettings *ss = SimulationSettings::create(simFile);
         if (ss)
         {
-            BlockChain *b = BlockChain::create(*ss);
-            if (b)
+            for (uint32_t i = 0; i < LL_COUNT; i++)
+            {
+                setLogSinks(LogLevel(i), ss->getLogSinks(LogLevel(i)));
+            }
+            setLogQuiet(quiet || ss->getLogQuiet());
+            if (gaussBenchmark)
+            {
+                benchmarkGauss(*ss, 1000000);
+            }
+            else if (runCount)
+            {
+                MonteCarlo *mc = MonteCarlo::create(*ss, runCount, threadCount);
+                mc->run();
+                mc->release();
+            }
+            else
             {
-                bool running = true;
-                while (running)
+                BlockChain *b = BlockChain::create(*ss);
+                if (b)
                 {
-                    running = b->pump();
+                    bool running = true;
+                    while (running)
+                    {
+                        running = b->pump();
+                    }
+                    b->release();
                 }
-                b->release();
             }
             ss->release();
         }
+        flushLog();
 	}
 	return 0;
 }
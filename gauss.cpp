@@ -4,6 +4,7 @@
 #include <string.h>
 #include <assert.h>
 #include <math.h>
+#include <float.h>
 
 #include "gauss.h"
 
@@ -65,7 +66,11 @@ float Gauss::Get(Rand &r)
 
   if ( HasGaussFlag(GF_LINEAR) )
   {
-    v = mMean + (ranfloat()*mStandardDeviation - (mStandardDeviation*0.5f));
+    v = mMean + (r.ranf()*mStandardDeviation - (mStandardDeviation*0.5f));
+  }
+  else if ( HasGaussFlag(GF_ZIGGURAT) )
+  {
+    v = RandZiggurat(r)*mStandardDeviation + mMean;
   }
   else
   {
@@ -87,6 +92,98 @@ float Gauss::Get(Rand &r)
   return v;
 };
 
+// out[i] = clamp(out[i]*scale + offset, low, high) over the whole array; a plain loop the compiler can vectorize
+static void scaleOffsetClamp(float *out, size_t n, float scale, float offset, float low, float high)
+{
+  for (size_t i = 0; i < n; i++)
+  {
+    float v = out[i] * scale + offset;
+    v = v < low ? low : v;
+    v = v > high ? high : v;
+    out[i] = v;
+  }
+}
+
+void Gauss::GetBatch(float *out, size_t n)
+{
+  GetBatch(*this, out, n);
+}
+
+void Gauss::GetBatch(Rand &r, float *out, size_t n)
+{
+  if ( n == 0 ) return;
+
+  if ( !HasGaussFlag(GF_STDEV) )
+  {
+    for (size_t i = 0; i < n; i++)
+    {
+      out[i] = mMean;
+    }
+    mCurrent = mMean;
+    return;
+  }
+
+  float scale = mStandardDeviation;
+  float offset = mMean;
+
+  if ( HasGaussFlag(GF_LINEAR) )
+  {
+    // the spread is worked out exactly as Get does and only the mean is added in the pass below,
+    // so each value rounds the same way
+    for (size_t i = 0; i < n; i++)
+    {
+      out[i] = r.ranf()*mStandardDeviation - (mStandardDeviation*0.5f);
+    }
+    scale = 1.0f;
+  }
+  else if ( HasGaussFlag(GF_ZIGGURAT) )
+  {
+    for (size_t i = 0; i < n; i++)
+    {
+      out[i] = RandZiggurat(r);
+    }
+  }
+  else
+  {
+    size_t i = 0;
+    if ( HasGaussFlag(GF_SECOND) ) // use up the cached half of the last pair first
+    {
+      ClearGaussFlag(GF_SECOND);
+      out[i++] = mGauss2;
+    }
+    while ( i < n )
+    {
+      float x1;
+      float x2;
+      float w;
+      do
+      {
+        x1 = 2.0f * r.ranf() - 1.0f;
+        x2 = 2.0f * r.ranf() - 1.0f;
+        w = x1 * x1 + x2 * x2;
+      } while ( w >= 1.0f || w == 0.0f );
+
+      w = sqrtf( (-2.0f * logf( w ) ) / w );
+      out[i++] = x1 * w;
+      if ( i < n )
+      {
+        out[i++] = x2 * w;
+      }
+      else
+      {
+        mGauss2 = x2 * w;
+        SetGaussFlag(GF_SECOND);
+      }
+    }
+  }
+
+  float low = HasGaussFlag(GF_MIN) ? mMin : -FLT_MAX;
+  float high = HasGaussFlag(GF_MAX) ? mMax : FLT_MAX;
+  scaleOffsetClamp(out, n, scale, offset, low, high);
+
+  mCurrent = out[n-1];
+}
+
 float Gauss::GetCurrent(void) const
 {
   return mCurrent;
@@ -98,6 +195,12 @@ const char * Gauss::Set(const char *arg)
   mFlags = 0;
   char *end;
   bool linear;
+  bool ziggurat = false;
+  if ( *arg == '~' )
+  {
+    ziggurat = true;
+    arg++;
+  }
   strtogmd( (char *)arg, &end, mMean, mStandardDeviation, mMin, mMax, linear );
 
   if ( mMean != 0.0f ) SetGaussFlag(GF_MEAN);
@@ -106,6 +209,7 @@ const char * Gauss::Set(const char *arg)
   if ( mMax != +DEFAULT_MIN_MAX )   SetGaussFlag(GF_MAX);
 
   if ( linear ) SetGaussFlag(GF_LINEAR);
+  if ( ziggurat ) SetGaussFlag(GF_ZIGGURAT);
 
   mCurrent = mMean;
 
@@ -121,6 +225,7 @@ void Gauss::GetString(String &str) const
   char prefix[2] = { 0, 0 };
 
   if ( HasGaussFlag(GF_LINEAR) ) prefix[0] = '!';
+  else if ( HasGaussFlag(GF_ZIGGURAT) ) prefix[0] = '~';
 
   if ( HasGaussFlag( (GaussFlag) (GF_STDEV | GF_MIN | GF_MAX) ) )
   {
@@ -158,7 +263,7 @@ float Gauss::RandGauss(Rand *r)
     x1 = 2.0f * r->ranf() - 1.0f;
     x2 = 2.0f * r->ranf() - 1.0f;
     w = x1 * x1 + x2 * x2;
-  } while ( w >= 1.0f );
+  } while ( w >= 1.0f || w == 0.0f );
 
   w = sqrtf( (-2.0f * logf( w ) ) / w );
 
@@ -170,6 +275,86 @@ float Gauss::RandGauss(Rand *r)
   return mGauss1;
 };
 
+// Marsaglia and Tsang's Ziggurat method with 128 layers.  The tables are built once during
+// static initialization and are read-only afterwards, so any number of threads can share them.
+#define ZIGGURAT_LAYERS 128
+#define ZIGGURAT_R 3.442619855899
+
+class ZigguratTables
+{
+public:
+  ZigguratTables(void)
+  {
+    const double m1 = 2147483648.0;
+    const double vn = 9.91256303526217e-3;
+    double dn = ZIGGURAT_R;
+    double tn = dn;
+    double q = vn / exp(-0.5 * dn * dn);
+
+    mK[0] = uint32_t((dn / q) * m1);
+    mK[1] = 0;
+    mW[0] = float(q / m1);
+    mW[ZIGGURAT_LAYERS - 1] = float(dn / m1);
+    mF[0] = 1.0f;
+    mF[ZIGGURAT_LAYERS - 1] = float(exp(-0.5 * dn * dn));
+
+    for (int32_t i = ZIGGURAT_LAYERS - 2; i >= 1; i--)
+    {
+      dn = sqrt(-2.0 * log(vn / dn + exp(-0.5 * dn * dn)));
+      mK[i + 1] = uint32_t((dn / tn) * m1);
+      tn = dn;
+      mF[i] = float(exp(-0.5 * dn * dn));
+      mW[i] = float(dn / m1);
+    }
+  }
+
+  uint32_t  mK[ZIGGURAT_LAYERS];    // acceptance thresholds
+  float     mW[ZIGGURAT_LAYERS];    // layer widths scaled to a 31 bit integer
+  float     mF[ZIGGURAT_LAYERS];    // density at the layer edges
+};
+
+static const ZigguratTables gZiggurat;
+
+// uniform number in the open interval (0,1); safe to take the log of
+static inline float openUnit(Rand &r)
+{
+  return (float(r.get64() >> 40) + 0.5f) * (1.0f / 16777216.0f);
+}
+
+float Gauss::RandZiggurat(Rand &r)
+{
+  for (;;)
+  {
+    // The layer index and the signed sample come from separate bits of one draw
+    uint64_t bits = r.get64();
+    uint32_t iz = uint32_t(bits & (ZIGGURAT_LAYERS - 1));
+    int32_t hz = int32_t(uint32_t(bits >> 32));
+    uint32_t absHz = hz < 0 ? uint32_t(0) - uint32_t(hz) : uint32_t(hz);
+    float x = float(hz) * gZiggurat.mW[iz];
+
+    if ( absHz < gZiggurat.mK[iz] )
+    {
+      return x; // inside the rectangle; the common case
+    }
+
+    if ( iz == 0 ) // sample from the tail beyond R
+    {
+      float y;
+      do
+      {
+        x = -logf(openUnit(r)) * float(1.0 / ZIGGURAT_R);
+        y = -logf(openUnit(r));
+      } while ( y + y < x * x );
+      return hz > 0 ? float(ZIGGURAT_R) + x : -float(ZIGGURAT_R) - x;
+    }
+
+    // wedge between layers; accept against the true density
+    if ( gZiggurat.mF[iz] + openUnit(r) * (gZiggurat.mF[iz - 1] - gZiggurat.mF[iz]) < expf(-0.5f * x * x) )
+    {
+      return x;
+    }
+  }
+}
 
 // convert string to gaussian number.  Return code
 // indicates number of arguments found.
@@ -270,19 +455,70 @@ int32_t Gauss::strtogmd(const char* spec,
   return 4;
 };
 
-static Rand frand;
 
-float ranfloat(void)
+uint32_t randPoisson(Rand &r, float mean)
 {
-  return frand.ranf();
-}
+  if ( mean <= 0.0f ) return 0;
 
+  if ( mean < 10.0f )
+  {
+    double limit = exp(-double(mean));
+    double p = 1.0;
+    uint32_t k = 0;
+    for (;;)
+    {
+      p *= r.ranf();
+      if ( p <= limit ) break;
+      k++;
+    }
+    return k;
+  }
 
+  double lam = mean;
+  double slam = sqrt(lam);
+  double loglam = log(lam);
+  double b = 0.931 + 2.53 * slam;
+  double a = -0.059 + 0.02483 * b;
+  double invalpha = 1.1239 + 1.1328 / (b - 3.4);
+  double vr = 0.9277 - 3.6224 / (b - 2.0);
+
+  for (;;)
+  {
+    double u = double(r.ranf()) - 0.5;
+    double v = double(r.ranf());
+    double us = 0.5 - fabs(u);
+    if ( us <= 0.0 ) continue;
+    double k = floor((2.0 * a / us + b) * u + lam + 0.43);
+    if ( us >= 0.07 && v <= vr )
+    {
+      return uint32_t(k);
+    }
+    if ( k < 0.0 || (us < 0.013 && v > us) )
+    {
+      continue;
+    }
+    if ( (log(v) + log(invalpha) - log(a / (us * us) + b)) <= (-lam + k * loglam - lgamma(k + 1.0)) )
+    {
+      return uint32_t(k);
+    }
+  }
+}
+
+// Each thread gets its own default seed source so that Gauss objects constructed by
+// concurrent simulations never share state.
+static thread_local Rand gSeedSource;
 
 void Gauss::srand(void)
 {
-  static Rand rand;
-  Rand::setSeed( rand.get() ); // randomize
+  srand(gSeedSource);
+}
+
+// Take the source's current sub-stream and jump the source past it, so every Gauss
+// seeded from the same source draws from its own non-overlapping sequence.
+void Gauss::srand(Rand &seedSource)
+{
+  *static_cast< Rand * >(this) = seedSource;
+  seedSource.jump();
 }
 
 
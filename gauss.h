@@ -22,6 +22,7 @@
 // **  30:5<10>    (Means 30, stdev +/-5 minimum value of 10
 // **  30:5<10:40> (Means 30, stdev +/-5, min value 10 max value 40)
 // ** !30:5        (Means 30, +/-5 using a straight linear function!
+// ** ~30:5        (Means 30, +/-5 sampled with the table driven Ziggurat method)
 
 #include "NvPreprocessor.h"
 #include "NsRand.h"
@@ -39,7 +40,8 @@ enum GaussFlag
   GF_MIN     = (1<<2),
   GF_MAX     = (1<<3),
   GF_LINEAR  = (1<<4),
-  GF_SECOND  = (1<<5)
+  GF_SECOND  = (1<<5),
+  GF_ZIGGURAT = (1<<6)   // sample normals with the Ziggurat tables rather than the polar method
 };
 
 // Implementation of gaussian numbers.
@@ -71,11 +73,18 @@ public:
   float Get(void);    // generate a random number
   float GetCurrent(void) const; // last generated value.
 
+  // Fill 'out' with 'n' samples, exactly the values 'n' calls to Get would return.  The deviates are
+  // drawn one after another in a single loop, then the scale, offset and min/max clamp are applied
+  // to the whole array in one pass; it saves the per-call overhead, it does not draw in parallel.
+  void GetBatch(Rand &r, float *out, size_t n);
+  void GetBatch(float *out, size_t n);
+
   void GetString(String &str) const; // get string representation
 
   const char * Set(const char *arg); // set from asciiz string.
 
   float RandGauss(Rand *r); // construct and return gaussian number.
+  float RandZiggurat(Rand &r); // standard normal deviate from the Ziggurat tables.
 
   // convert string to gaussian number.  Return code
   // indicates number of arguments found.
@@ -92,7 +101,8 @@ public:
   float GetMin(void)               const { return mMin; };
   float GetMax(void)               const { return mMax; };
 
-  void srand(void);
+  void srand(void);                // reseed from this thread's default seed source
+  void srand(Rand &seedSource);     // take an independent sub-stream from a caller owned source; reproducible per simulation instance
 
   void Reset(void);
 
@@ -150,7 +160,9 @@ private:
   float mGauss2;            // 2nd gaussian
 };
 
-float ranfloat(void);
+// Draw a Poisson distributed count with the given mean using the supplied random number generator.
+// Small means use Knuth's multiplication method, large means use Hormann's PTRS transformed rejection.
+uint32_t randPoisson(Rand &r, float mean);
 
 };
 
@@ -4,7 +4,12 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdarg.h>
-#include <time.h>
+#include "MpscRing.h"
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 
 
 #ifdef _MSC_VER
@@ -15,51 +20,300 @@
 namespace blockchainsim
 {
 
-    // This is a helper method to handle logging the output from scanning the blockchain
+    #define LOG_RECORD_SIZE 1024        // longer messages are cut short
+    #define LOG_RING_SIZE 1024          // messages queued before a logging thread has to wait
+    #define LOG_IDLE_WAIT 10            // milliseconds the writer sleeps when there is nothing to write
+
+    class LogRecord
+    {
+    public:
+        uint32_t    mSinks;
+        uint32_t    mLength;
+        char        mText[LOG_RECORD_SIZE];
+    };
+
+    // Owns the queue and the thread that empties it; built by the first message logged
+    class Logger
+    {
+    public:
+        Logger(void) : mRing(LOG_RING_SIZE)
+        {
+            mFile = nullptr;
+            mQuiet.store(false);
+            for (uint32_t i = 0; i < LL_COUNT; i++)
+            {
+                mSinks[i].store(LS_CONSOLE | LS_FILE);
+            }
+            mQueued.store(0);
+            mWritten.store(0);
+            mIdle.store(false);
+            mStop = false;
+            mThread = std::thread(&Logger::writerThread, this);
+        }
+
+        ~Logger(void)
+        {
+            {
+                std::lock_guard< std::mutex > lock(mLock);
+                mStop = true;
+            }
+            mSignal.notify_one();
+            mThread.join();
+            if (mFile)
+            {
+                fclose(mFile);
+            }
+        }
+
+        uint32_t getSinks(LogLevel level) const
+        {
+            return mQuiet.load(std::memory_order_relaxed) ? 0 : mSinks[level].load(std::memory_order_relaxed);
+        }
+
+        void log(uint32_t sinks, const char *fmt, va_list arg)
+        {
+            LogRecord r;
+            r.mSinks = sinks;
+            int32_t len = stringFormatV(r.mText, sizeof(r.mText), fmt, arg);
+            if (len < 0)
+            {
+                return;
+            }
+            if (uint32_t(len) >= sizeof(r.mText))
+            {
+                len = int32_t(sizeof(r.mText) - 1);
+                r.mText[len - 1] = '\n';
+            }
+            r.mLength = uint32_t(len);
+            // Counted before it is queued, so a flush also waits for anything queued ahead of its own messages
+            mQueued.fetch_add(1);
+            // Nothing is ever dropped; a full queue holds the caller up until the writer catches up
+            while (!mRing.push(r))
+            {
+                wake();
+                std::this_thread::yield();
+            }
+            wake();
+        }
+
+        void flush(void)
+        {
+            uint64_t target = mQueued.load();
+            while (mWritten.load(std::memory_order_acquire) < target)
+            {
+                wake();
+                std::this_thread::yield();
+            }
+        }
+
+        std::atomic< uint32_t > mSinks[LL_COUNT];
+        std::atomic< bool >     mQuiet;
+
+    private:
+        void wake(void)
+        {
+            if (mIdle.load(std::memory_order_acquire))
+            {
+                mSignal.notify_one();
+            }
+        }
+
+        void writerThread(void)
+        {
+            for (;;)
+            {
+                uint32_t written = 0;
+                while (mRing.pop(mRecord))
+                {
+                    write(mRecord);
+                    written++;
+                }
+                if (written)
+                {
+                    fflush(stdout);
+                    if (mFile)
+                    {
+                        fflush(mFile);
+                    }
+                    mWritten.fetch_add(written, std::memory_order_release);
+                    continue;
+                }
+                std::unique_lock< std::mutex > lock(mLock);
+                if (mStop)
+                {
+                    break;      // the queue is empty and no one else can log any more
+                }
+                mIdle.store(true, std::memory_order_release);
+                mSignal.wait_for(lock, std::chrono::milliseconds(LOG_IDLE_WAIT));
+                mIdle.store(false, std::memory_order_release);
+            }
+        }
+
+        void write(const LogRecord &r)
+        {
+            if (r.mSinks & LS_CONSOLE)
+            {
+                fwrite(r.mText, 1, r.mLength, stdout);
+            }
+            if (r.mSinks & LS_FILE)
+            {
+                if (mFile == nullptr)
+                {
+                    mFile = fopen("blockchainsim.txt", "wb");
+                }
+                if (mFile)
+                {
+                    fwrite(r.mText, 1, r.mLength, mFile);
+                }
+            }
+        }
+
+        MpscRing< LogRecord >   mRing;
+        std::atomic< uint64_t > mQueued;
+        std::atomic< uint64_t > mWritten;
+        std::atomic< bool >     mIdle;          // the writer is waiting to be woken
+        std::mutex              mLock;
+        std::condition_variable mSignal;
+        bool                    mStop;
+        LogRecord               mRecord;        // the writer's copy of the record being written
+        FILE                    *mFile;
+        std::thread             mThread;
+    };
+
+    static Logger &getLogger(void)
+    {
+        static Logger gLogger;
+        return gLogger;
+    }
+
     void logMessage(const char *fmt, ...)
     {
-        static FILE		*gLogFile = NULL;
-        char wbuff[2048];
-        va_list arg;
-        va_start(arg, fmt);
-        vsprintf(wbuff, fmt, arg);
-        va_end(arg);
-        printf("%s", wbuff);
-        if (gLogFile == NULL)
+        Logger &l = getLogger();
+        uint32_t sinks = l.getSinks(LL_INFO);
+        if (sinks)
         {
-            gLogFile = fopen("blockchainsim.txt", "wb");
+            va_list arg;
+            va_start(arg, fmt);
+            l.log(sinks, fmt, arg);
+            va_end(arg);
         }
-        if (gLogFile)
+    }
+
+    void logMessage(LogLevel level, const char *fmt, ...)
+    {
+        Logger &l = getLogger();
+        uint32_t sinks = l.getSinks(level);
+        if (sinks)
         {
-            fprintf(gLogFile, "%s", wbuff);
-            fflush(gLogFile);
+            va_list arg;
+            va_start(arg, fmt);
+            l.log(sinks, fmt, arg);
+            va_end(arg);
         }
     }
 
+    void setLogSinks(LogLevel level, uint32_t sinks)
+    {
+        getLogger().mSinks[level].store(sinks);
+    }
 
-    const char *getDateString(uint32_t _t)
+    void setLogQuiet(bool quiet)
     {
-        time_t t(_t);
-        static char scratch[1024];
-        struct tm *gtm = gmtime(&t);
-        //	strftime(scratch, 1024, "%m, %d, %Y", gtm);
-        sprintf(scratch, "%4d-%02d-%02d", gtm->tm_year + 1900, gtm->tm_mon + 1, gtm->tm_mday);
-        return scratch;
+        getLogger().mQuiet.store(quiet);
     }
 
-    const char *getTimeString(uint32_t timeStamp)
+    void flushLog(void)
+    {
+        getLogger().flush();
+    }
+
+    #define SECONDS_PER_DAY (24*60*60)
+
+    // two digits of 'v', which is under 100
+    static void formatTwoDigits(char *dst, uint32_t v)
+    {
+        dst[0] = char('0' + v / 10);
+        dst[1] = char('0' + v % 10);
+    }
+
+    TimeFormatter::TimeFormatter(void)
+    {
+        setDay(0);
+    }
+
+    // Gregorian calendar date of a day number, counted in 400 year eras that start on the 1st of March
+    void TimeFormatter::setDay(uint32_t day)
+    {
+        mDay = day;
+        uint32_t z = day + 719468;                  // days from 0000-03-01 to 1970-01-01
+        uint32_t era = z / 146097;
+        uint32_t dayOfEra = z - era * 146097;
+        uint32_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+        uint32_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+        uint32_t mp = (5 * dayOfYear + 2) / 153;    // months from March
+        uint32_t d = dayOfYear - (153 * mp + 2) / 5 + 1;
+        uint32_t m = mp < 10 ? mp + 3 : mp - 9;
+        uint32_t y = yearOfEra + era * 400 + (m <= 2 ? 1 : 0);
+        formatTwoDigits(mDate, m);
+        mDate[2] = '/';
+        formatTwoDigits(mDate + 3, d);
+        mDate[5] = '/';
+        formatTwoDigits(mDate + 6, y / 100);
+        formatTwoDigits(mDate + 8, y % 100);
+        mDate[10] = ' ';
+        memcpy(mIsoDate, mDate + 6, 4);
+        mIsoDate[4] = '-';
+        formatTwoDigits(mIsoDate + 5, m);
+        mIsoDate[7] = '-';
+        formatTwoDigits(mIsoDate + 8, d);
+    }
+
+    const char *TimeFormatter::formatTime(uint32_t timeStamp, char *dst)
     {
         if (timeStamp == 0)
         {
-            return "NEVER";
+            memcpy(dst, "NEVER", 6);
+            return dst;
+        }
+        uint32_t day = timeStamp / SECONDS_PER_DAY;
+        if (day != mDay)
+        {
+            setDay(day);
+        }
+        uint32_t seconds = timeStamp - day * SECONDS_PER_DAY;
+        memcpy(dst, mDate, sizeof(mDate));
+        formatTwoDigits(dst + 11, seconds / 3600);
+        dst[13] = ':';
+        formatTwoDigits(dst + 14, (seconds / 60) % 60);
+        dst[16] = ':';
+        formatTwoDigits(dst + 17, seconds % 60);
+        dst[19] = 0;
+        return dst;
+    }
+
+    const char *TimeFormatter::formatDate(uint32_t timeStamp, char *dst)
+    {
+        uint32_t day = timeStamp / SECONDS_PER_DAY;
+        if (day != mDay)
+        {
+            setDay(day);
         }
-        static char scratch[1024];
-        time_t t(timeStamp);
-        struct tm *gtm = gmtime(&t);
-        strftime(scratch, 1024, "%m/%d/%Y %H:%M:%S", gtm);
-        return scratch;
+        memcpy(dst, mIsoDate, sizeof(mIsoDate));
+        dst[10] = 0;
+        return dst;
     }
 
+    static thread_local TimeFormatter   gTimeFormatter;
+    static thread_local char            gTimeString[TIME_STRING_SIZE];
+
+    const char *getDateString(uint32_t _t)
+    {
+        return gTimeFormatter.formatDate(_t, gTimeString);
+    }
 
+    const char *getTimeString(uint32_t timeStamp)
+    {
+        return gTimeFormatter.formatTime(timeStamp, gTimeString);
+    }
 
 } // end of namespace
\ No newline at end of file
@@ -6,7 +6,62 @@
 namespace blockchainsim
 {
 
-    void logMessage(const char *fmt, ...);
+    // How important a message is; each level is routed to its own set of sinks
+    enum LogLevel
+    {
+        LL_ERROR,
+        LL_WARNING,
+        LL_INFO,
+        LL_PROGRESS,        // a line per block mined
+        LL_COUNT
+    };
+
+    // where the messages of a level go; a combination of flags
+    enum LogSink
+    {
+        LS_CONSOLE  = (1<<0),
+        LS_FILE     = (1<<1),       // blockchainsim.txt
+    };
+
+    // Messages are formatted on the calling thread and queued; a background thread writes them out,
+    // so logging never waits on the console or the disk.  Safe to call from any number of threads.
+    void logMessage(const char *fmt, ...);      // at LL_INFO
+    void logMessage(LogLevel level, const char *fmt, ...);
+
+    // every level starts out going to both the console and the file
+    void setLogSinks(LogLevel level, uint32_t sinks);
+
+    // drop every message, whatever the sinks are, until turned off again
+    void setLogQuiet(bool quiet);
+
+    // waits until every message logged so far has been written out
+    void flushLog(void);
+
+    #define TIME_STRING_SIZE 20     // "MM/DD/YYYY HH:MM:SS" and its terminator
+
+    // Formats time stamps (seconds since 1970, UTC) into the caller's buffer.  The date is worked out
+    // once per day and cached, and the time of day is plain arithmetic, so nothing calls into the C
+    // library's time functions.  Each thread, or each simulation instance, keeps its own formatter.
+    class TimeFormatter
+    {
+    public:
+        TimeFormatter(void);
+
+        // "MM/DD/YYYY HH:MM:SS", or "NEVER" for zero; returns 'dst', which holds TIME_STRING_SIZE bytes
+        const char *formatTime(uint32_t timeStamp, char *dst);
+
+        // "YYYY-MM-DD"; returns 'dst', which holds TIME_STRING_SIZE bytes
+        const char *formatDate(uint32_t timeStamp, char *dst);
+
+    private:
+        void setDay(uint32_t day);
+
+        uint32_t    mDay;               // days since 1970 that the strings below hold
+        char        mDate[11];          // "MM/DD/YYYY "
+        char        mIsoDate[10];       // "YYYY-MM-DD"
+    };
+
+    // The same, into a buffer of the calling thread's that the next call on that thread overwrites
     const char *getDateString(uint32_t _t);
     const char *getTimeString(uint32_t timeStamp);
 